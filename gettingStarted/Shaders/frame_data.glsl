@@ -0,0 +1,7 @@
+// per-frame values, one buffer update a frame (FrameData in application.cpp)
+layout (std140) uniform FrameData
+{
+	mat4 viewProjection;
+	float time;
+	float alpha;
+};
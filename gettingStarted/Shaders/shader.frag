@@ -5,15 +5,34 @@ out vec4 FragColor;
 //in vec3 ourColor;
 in vec2 TexCoord;
 
+#include "frame_data.glsl"
+
+#ifdef TEXTURE_ARRAY
+// both images as layers of one array texture, picked by layer index
+uniform sampler2DArray textures;
+uniform int layer1;
+uniform int layer2;
+#else
 uniform sampler2D texture1;
 uniform sampler2D texture2;
-uniform float alpha;
+#endif
 
 void main()
 {
 	// sample colour of a texture
 	// FragColor = texture(ourTexture, TexCoord) * vec4(ourColor, 1.0);
 
+#if defined(TEXTURE_ARRAY) && defined(SINGLE_TEXTURE)
+	// alpha is 0 or 1 so only one image shows, layer1 is pointed at it
+	FragColor = texture(textures, vec3(TexCoord, layer1));
+#elif defined(TEXTURE_ARRAY)
+	FragColor = mix(texture(textures, vec3(TexCoord, layer1)),
+					texture(textures, vec3(TexCoord, layer2)), alpha);
+#elif defined(SINGLE_TEXTURE)
+	// alpha is 0 or 1 so only one image shows, texture1 is pointed at it
+	FragColor = texture(texture1, TexCoord);
+#else
 	FragColor = mix(texture(texture1, TexCoord),
 					texture(texture2, TexCoord), alpha);
+#endif
 }
\ No newline at end of file
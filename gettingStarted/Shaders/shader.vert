@@ -1,19 +1,44 @@
 #version 330 core
+#ifdef SEPARABLE
+#extension GL_ARB_separate_shader_objects : enable
+out gl_PerVertex { vec4 gl_Position; };
+#endif
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec2 aTexCoord;
+#if defined(INSTANCED) && defined(AFFINE_2D)
+layout (location = 3) in vec3 aAffineRow0; // per instance 2D transform: a c tx
+layout (location = 4) in vec3 aAffineRow1; //                            b d ty
+#elif defined(INSTANCED)
+layout (location = 3) in mat4 aTransform; // per instance, takes locations 3-6
+#endif
 
 //out vec3 ourColor;
 out vec2 TexCoord;
 
+#include "frame_data.glsl"
+
 uniform float offset;
+#ifndef INSTANCED
 uniform mat4 transform;
+#endif
 
 void main()
 {
 	//gl_Position = vec4(aPos, 1.0); // normal one
-	gl_Position = transform * vec4(aPos, 1.0f);
+#if defined(INSTANCED) && defined(AFFINE_2D)
+	vec3 position = vec3(aPos.xy, 1.0f);
+	gl_Position = viewProjection * vec4(dot(aAffineRow0, position),
+		dot(aAffineRow1, position), aPos.z, 1.0f);
+#else
+#ifdef INSTANCED
+	mat4 model = aTransform;
+#else
+	mat4 model = transform;
+#endif
+	gl_Position = viewProjection * model * vec4(aPos, 1.0f);
+#endif
 	//ourColor = aColor;
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
 }
\ No newline at end of file
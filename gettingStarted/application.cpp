@@ -1,6 +1,21 @@
 // based on learnopengl.com tutorial
 
+#include "gl_debug.h"
+#include "gl_state.h"
 #include "shader.h"
+#include "shader_variants.h"
+#include "shader_reload.h"
+#include "uniform_buffer.h"
+#include "instance_buffer.h"
+#include "transform2d.h"
+#include "transform_store.h"
+#include "texture.h"
+#include "texture_manager.h"
+#include "texture_array.h"
+#include "benchmarks.h"
+#ifdef EMBED_SHADERS
+#include "embedded_shaders.h" // generated by the Release pre-build step
+#endif
 
 #include <glad/glad.h> 
 #include <GLFW/glfw3.h>
@@ -19,32 +34,51 @@
 
 
 ////////////////////////////////////////////////////////////////
+// GLOBAL VARS & FUNCTION DECLARATIONS
 
 
-// error handling - end program
-#define ASSERT(x) if (!(x)) __debugbreak() // for MSVC compiler
-
-// error handling - end program and show line/file
-#define GLCall(x) GLClearError();\
-    x;\
-    ASSERT(GLLogCall(#x, __FILE__, __LINE__)) // # changes to string
+// load both images as layers of one GL_TEXTURE_2D_ARRAY, bound once
+//#define USE_TEXTURE_ARRAY
 
+// print the timings in benchmarks.h once at startup
+//#define RUN_BENCHMARKS
 
-////////////////////////////////////////////////////////////////
-// GLOBAL VARS & FUNCTION DECLARATIONS
-
+// print the per-frame counters (state cache, uploads, residency) every frame
+//#define PRINT_FRAME_STATS
 
 constexpr int WIDTH = 800;
 constexpr int HEIGHT = 600;
 constexpr float ALPHA_DIFF = 0.001;
 constexpr float ALPHA_INIT = 0.5;
-float alpha = 0.5; // 2nd texture's actual transparency, lazy storage
+float alpha = ALPHA_INIT; // 2nd texture's actual transparency, lazy storage
+
+// per-frame values, must match Shaders/frame_data.glsl
+struct FrameData {
+    glm::mat4 viewProjection;
+    float time;
+    float alpha;
+    float padding[2];
+};
+STD140_FIRST_MEMBER(FrameData, viewProjection);
+STD140_MEMBER(FrameData, time, viewProjection);
+STD140_MEMBER(FrameData, alpha, time);
+constexpr unsigned int FRAME_DATA_BINDING = 0;
+
+// shader variants, bit i of a mask turns on the i-th #define key
+enum ShaderVariant : uint32_t {
+    VARIANT_DEFAULT = 0,
+    VARIANT_SINGLE_TEXTURE = 1 << 0,
+    VARIANT_INSTANCED = 1 << 1,
+    VARIANT_AFFINE_2D = 1 << 2, // instances are Affine2D, not mat4
+    VARIANT_TEXTURE_ARRAY = 1 << 3, // images are layers of one array texture
+};
+const std::vector<std::string> SHADER_VARIANT_KEYS = {
+    "SINGLE_TEXTURE", "INSTANCED", "AFFINE_2D", "TEXTURE_ARRAY" };
+constexpr unsigned int INSTANCE_TRANSFORM_LOCATION = 3;
 
 
-static void GLClearError();
-static bool GLLogCall(const char* function, const char* file, int line);
 void framebuffer_size_callback(GLFWwindow * window, int width, int height);
-void processInput(GLFWwindow * window, Shader * shader);
+void processInput(GLFWwindow * window);
 GLFWwindow* setupWindow();
 
 
@@ -61,63 +95,31 @@ int main()
     //////////////////////////////////////////////////////////////////
 
 
-    int width, height, nrChannels; // temp vars
-
-    // load textures
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glGenTextures(1, &texture2);
-
     // flip images loaded by stbi
     stbi_set_flip_vertically_on_load(true);
 
-
-
-    // set 1st texture unit ////////////////////
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    // set texture wrapping for s & t (as repeat)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering for minifying/magnifying (as linear interpolation)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    unsigned char* data = stbi_load(".\\Images\\container.jpg", &width, &height,
-        &nrChannels, 0);
-    // generate mipmap if successful
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-            GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture 1\n";
-    }
-    stbi_image_free(data);
-
-
-
-    // set 2nd texture unit ///////////////////////////
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // set texture wrapping for s & t (as repeat)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering for minifying/magnifying (as linear interpolation)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    data = stbi_load(".\\Images\\awesomeface.png", &width, &height,
-        &nrChannels, 0);
-    // generate mipmap if successful
-    if (data) {
-        // https://stackoverflow.com/questions/23150123/loading-png-with-stb-image-for-opengl-texture-gives-wrong-colors
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA,
-            GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture 2\n";
-    }
-    stbi_image_free(data);
+    GLStateCache& glState = GLStateCache::get(); // every bind goes through it
+
+#ifdef USE_TEXTURE_ARRAY
+    // both images as layers of one array texture, a single bind for all
+    TextureArray textures{ 512, 512, 2 };
+    textures.loadLayer(0, ".\\Images\\container.jpg");
+    textures.loadLayer(1, ".\\Images\\awesomeface.png");
+    textures.generateMipmaps();
+#else
+    // decoded on worker threads and uploaded when ready, a placeholder shows
+    // until then. sized formats from each image's channels, full mip chains
+    // uploads drained at most 1MB or 2ms a frame, so images landing together
+    // don't make a frame spike
+    UploadScheduler uploads{ 1 << 20, 2.0 };
+    // the same file (or the same bytes under another name) loads only once,
+    // above 64MB the textures bound longest ago are evicted
+    TextureManager textureManager{ 2, &uploads, 64 << 20 };
+    // BC1/BC3 in GPU memory, encoded on the workers the first time only
+    //textureManager.enableCompression(".\\TextureCache");
+    Texture2D texture1 = textureManager.load(".\\Images\\container.jpg");
+    Texture2D texture2 = textureManager.load(".\\Images\\awesomeface.png");
+#endif
 
 
 
@@ -139,17 +141,17 @@ int main()
     };
     unsigned int VAO;
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     unsigned int VBO;
     glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     
     // EBO for reusing indices
     unsigned int EBO;
     glGenBuffers(1, &EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // specify how to read the vertices / vertex attrib config
@@ -165,60 +167,139 @@ int main()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // per-instance 2D transforms (two vec3 rows at locations 3-4), every
+    // container in one draw
+    InstanceBuffer<Affine2D> instances{ INSTANCE_TRANSFORM_LOCATION };
+
+    // positions, angles and scales of every container, turned into matrices
+    // in one pass each frame
+    TransformStore transforms;
+    size_t rotatingContainer = transforms.add(0.5f, -0.5f);
+    size_t scalingContainer = transforms.add(-0.5f, 0.5f);
+
 
     //////////////////////////////////////////////////////////////
 
 
-    Shader shaderProgram{ ".\\Shaders\\shader.vert", ".\\Shaders\\shader.frag" };
-    shaderProgram.use();
-    shaderProgram.setInt("texture1", 0);
-    shaderProgram.setInt("texture2", 1);
-    shaderProgram.setFloat("alpha", 0.5);
+    // cache linked program binaries on disk (directory must exist)
+    //Shader::enableBinaryCache(".\\ShaderCache");
+
+    UniformBuffer<FrameData> frameData{ FRAME_DATA_BINDING };
+    frameData.data.viewProjection = glm::mat4(1.0f);
+
+    // sampler units and block bindings are per program, set them on each variant
+    auto setupShader = [&frameData](Shader& shader) {
+#ifdef USE_TEXTURE_ARRAY
+        shader.setInt(UNIFORM("textures"), 0);
+        shader.setInt(UNIFORM("layer1"), 0); // crate
+        shader.setInt(UNIFORM("layer2"), 1); // face
+#else
+        shader.setInt(UNIFORM("texture1"), 0);
+        shader.setInt(UNIFORM("texture2"), 1);
+#endif
+        frameData.bindTo(shader, "FrameData");
+    };
+#ifdef EMBED_SHADERS
+    // packaged build, the shaders are compiled into the executable
+    ShaderVariants shaders{ EMBEDDED_SHADER_VERT, EMBEDDED_SHADER_FRAG,
+        SHADER_VARIANT_KEYS, setupShader };
+#else
+    // edited shaders are rebuilt in the background and swapped in once linked
+    ShaderHotReload reloader{ window };
+    ShaderVariants shaders{ ".\\Shaders\\shader.vert", ".\\Shaders\\shader.frag",
+        SHADER_VARIANT_KEYS, [&](Shader& shader) {
+            setupShader(shader);
+            reloader.watch(shader, setupShader);
+        } };
+#endif
+
+#ifdef RUN_BENCHMARKS
+    benchUniformSetters(shaders.get(VARIANT_DEFAULT));
+    benchTransforms();
+    benchCompression(".\\Images");
+#endif
 
     /////////////////////////////////////////////////////////////
 
     // prepare to draw
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     // wireframe mode
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     while (!glfwWindowShouldClose(window))
     {
+        GLDebugNewFrame();
+        glState.beginFrame();
+#ifdef PRINT_FRAME_STATS
+        // binds that reached GL last frame, and the ones dropped as redundant
+        std::cout << glState.lastFrameStats().issued << " issued, "
+            << glState.lastFrameStats().elided << " elided" << std::endl;
+#endif
+
         // input
-        processInput(window, &shaderProgram);
+        processInput(window);
+#ifndef EMBED_SHADERS
+        reloader.update();
+#endif
+#ifndef USE_TEXTURE_ARRAY
+        textureManager.update();
+        uploads.update();
+#ifdef PRINT_FRAME_STATS
+        std::cout << textureManager.residency().lastFrameStats().residentBytes << " bytes resident, "
+            << textureManager.residency().lastFrameStats().evicted << " evicted" << std::endl;
+        std::cout << uploads.lastFrameStats().bytesUploaded << " bytes uploaded, "
+            << uploads.lastFrameStats().queueDepth << " queued" << std::endl;
+#endif
+#endif
+
+        // per-frame uniforms in a single buffer update
+        frameData.data.time = (float)glfwGetTime();
+        frameData.data.alpha = alpha;
+        frameData.upload();
 
         // render
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // bind textures on corresponding texture units
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1); // crate
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2); // face
-
-        // 1st rotating container
-        glm::mat4 trans = glm::mat4(1.0f);
-        trans = glm::translate(trans, glm::vec3(0.5f, -0.5f, 0.0f));
-        trans = glm::rotate(trans, (float)glfwGetTime(),
-            glm::vec3(0.0f, 0.0f, 1.0f));
-        // pass the trans matrix to the shader
-        unsigned int transformLoc = glGetUniformLocation(shaderProgram.ID, "transform");
-        glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
-       
-        GLCall(glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0));
-
+        // at alpha 0 or 1 only one image is visible, sample just that one
+        bool singleTexture = alpha <= 0.0f || 1.0f <= alpha;
+#ifdef USE_TEXTURE_ARRAY
+        Shader& shaderProgram = shaders.get(VARIANT_INSTANCED | VARIANT_AFFINE_2D |
+            VARIANT_TEXTURE_ARRAY | (singleTexture ? VARIANT_SINGLE_TEXTURE : VARIANT_DEFAULT));
+        shaderProgram.use();
+        if (singleTexture)
+            shaderProgram.setInt(UNIFORM("layer1"), alpha <= 0.0f ? 0 : 1);
+
+        // one binding holds every image
+        glState.bindTexture(0, GL_TEXTURE_2D_ARRAY, textures.ID);
+#else
+        Shader& shaderProgram = shaders.get(VARIANT_INSTANCED | VARIANT_AFFINE_2D |
+            (singleTexture ? VARIANT_SINGLE_TEXTURE : VARIANT_DEFAULT));
+        shaderProgram.use();
+        if (singleTexture)
+            shaderProgram.setInt(UNIFORM("texture1"), alpha <= 0.0f ? 0 : 1);
+
+        // bind textures on corresponding texture units (dropped while unchanged)
+        glState.bindTexture(0, GL_TEXTURE_2D, texture1.id()); // crate
+        glState.bindTexture(1, GL_TEXTURE_2D, texture2.id()); // face
+#endif
+
+        // 1st rotating container, wrapped to one turn for the fast sin/cos
+        transforms.angle[rotatingContainer] = (float)fmod(glfwGetTime(), 2.0 * 3.14159265358979);
 
         // 2nd scaling container
-        trans = glm::mat4(1.0f);
-        trans = glm::translate(trans, glm::vec3(-0.5f, 0.5f, 0.0f));
-        trans = glm::scale(trans, glm::vec3(sin((float)glfwGetTime()),
-            sin((float)glfwGetTime()), 0.0f));
-        // pass the trans matrix to the shader
-        glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
-        
-        GLCall(glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0));
+        transforms.scaleX[scalingContainer] = sin((float)glfwGetTime());
+        transforms.scaleY[scalingContainer] = sin((float)glfwGetTime());
+
+        // compute all the transforms into the instance buffer and draw them at once
+        if (Affine2D* mapped = instances.map(transforms.size()))
+        {
+            transforms.compute(mapped);
+            instances.unmap();
+        }
+        GLCall(glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0,
+            (GLsizei)instances.count));
 
 
         glfwSwapBuffers(window); // prevent flickering
@@ -229,6 +310,18 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    instances.release();
+#ifdef USE_TEXTURE_ARRAY
+    glDeleteTextures(1, &textures.ID);
+#else
+    texture1.reset(); // last references, deleted right here
+    texture2.reset();
+    textureManager.stop();
+#endif
+    frameData.release();
+#ifndef EMBED_SHADERS
+    reloader.stop();
+#endif
 
     // clean/delete GLFW's allocated resources
     glfwTerminate();
@@ -252,6 +345,10 @@ GLFWwindow* setupWindow() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifndef NDEBUG
+    // lets the driver report errors through KHR_debug, see gl_debug.h
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
     // for apple
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -272,6 +369,7 @@ GLFWwindow* setupWindow() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         __debugbreak();
     }
+    GLDebugSetup();
 
     // size of rendering window
     glViewport(0, 0, WIDTH, HEIGHT);
@@ -282,20 +380,6 @@ GLFWwindow* setupWindow() {
     return window;
 }
 
-static void GLClearError() {
-    while (glGetError() != GL_NO_ERROR); // 0 or GL_NO_ERROR
-}
-
-static bool GLLogCall(const char* function, const char* file, int line) {
-    bool isError = true;
-    while (GLenum error = glGetError()) {
-        isError = false;
-        std::cout << "[OpenGL Error]" << "(" << error << "): " << function
-            << " " << file << ": " << line << std::endl;
-    }
-    return isError;
-}
-
 // in case of window resize to new width, height
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
@@ -303,18 +387,16 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 }
 
 // escape key -> close
-void processInput(GLFWwindow* window, Shader* shader)
+void processInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
         if (alpha <= 1.0)
             alpha += ALPHA_DIFF;
-        shader->setFloat("alpha", alpha);
     }
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
         if (0.0 <= alpha)
             alpha -= ALPHA_DIFF;
-        shader->setFloat("alpha", alpha);
     }
 }
\ No newline at end of file
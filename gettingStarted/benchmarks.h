@@ -0,0 +1,289 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "transform_store.h"
+#include "block_compress.h"
+#include "stb_image.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+
+// one-off timings, run once at startup with RUN_BENCHMARKS in application.cpp
+
+typedef std::chrono::steady_clock BenchClock;
+
+double benchMilliseconds(BenchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// per call cost of setting a uniform: looked up by string on every call as
+// the setters used to do, through a UniformId hashed from a std::string and
+// from a plain literal when the call runs, and one hashed at compile time by
+// UNIFORM(). the lookup goes through the same GL entry point setInt uses, so
+// only the lookup differs. the value changes on every call so the shadow copy
+// never skips one. shader must have an int (sampler) uniform "texture1",
+// which is left at 0
+void benchUniformSetters(Shader& shader)
+{
+	const int CALLS = 100000;
+	const std::string name = "texture1";
+	shader.use();
+	glFinish();
+
+	BenchClock::time_point start = BenchClock::now();
+	for (int i = 0; i < CALLS; i++)
+	{
+		int location = glGetUniformLocation(shader.ID, name.c_str());
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+		if (GLHasSeparateShaderObjects())
+		{
+			glProgramUniform1i(shader.ID, location, i & 1);
+			continue;
+		}
+#endif
+		glUniform1i(location, i & 1);
+	}
+	glFinish();
+	double byLookup = benchMilliseconds(start);
+	shader.invalidateUniforms(); // set behind the shadow copy's back
+
+	start = BenchClock::now();
+	for (int i = 0; i < CALLS; i++)
+		shader.setInt(name, i & 1);
+	glFinish();
+	double byString = benchMilliseconds(start);
+
+	start = BenchClock::now();
+	for (int i = 0; i < CALLS; i++)
+		shader.setInt("texture1", i & 1);
+	glFinish();
+	double byLiteral = benchMilliseconds(start);
+
+	start = BenchClock::now();
+	for (int i = 0; i < CALLS; i++)
+		shader.setInt(UNIFORM("texture1"), i & 1);
+	glFinish();
+	double byConstant = benchMilliseconds(start);
+
+	shader.setInt(UNIFORM("texture1"), 0);
+	std::cout << "uniform setters, ns per call over " << CALLS << " calls:\n"
+		<< "  glGetUniformLocation each call: " << byLookup * 1e6 / CALLS << "\n"
+		<< "  UniformId from std::string:     " << byString * 1e6 / CALLS << "\n"
+		<< "  UniformId from a literal:       " << byLiteral * 1e6 / CALLS << "\n"
+		<< "  UNIFORM() at compile time:      " << byConstant * 1e6 / CALLS << std::endl;
+}
+
+// matrices per second from TransformStore::compute against the per-object
+// glm::translate/rotate/scale it replaced, at 1k, 100k and 1M objects. each
+// size repeats until about 10M matrices are built, so timings are comparable
+void benchTransforms()
+{
+	const size_t SIZES[] = { 1000, 100000, 1000000 };
+	const size_t MATRICES_PER_SIZE = 10000000;
+	float checksum = 0.0f; // read back so nothing gets optimized away
+
+	for (size_t size : SIZES)
+	{
+		TransformStore transforms;
+		for (size_t i = 0; i < size; i++)
+		{
+			float random = (float)rand() / RAND_MAX;
+			// angles wrapped to one turn, as the app keeps them
+			transforms.add(random * 2.0f - 1.0f, 1.0f - random, random * 6.2831853f,
+				0.5f + random, 1.5f - random);
+		}
+		size_t repeats = MATRICES_PER_SIZE / size;
+
+		std::vector<glm::mat4> models(size);
+		BenchClock::time_point start = BenchClock::now();
+		for (size_t repeat = 0; repeat < repeats; repeat++)
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				glm::mat4 model = glm::translate(glm::mat4(1.0f),
+					glm::vec3(transforms.posX[i], transforms.posY[i], 0.0f));
+				model = glm::rotate(model, transforms.angle[i], glm::vec3(0.0f, 0.0f, 1.0f));
+				models[i] = glm::scale(model, glm::vec3(transforms.scaleX[i], transforms.scaleY[i], 1.0f));
+			}
+			checksum += models[repeat % size][0][0];
+		}
+		double glmMilliseconds = benchMilliseconds(start);
+
+		std::vector<Affine2D> affines(size);
+		start = BenchClock::now();
+		for (size_t repeat = 0; repeat < repeats; repeat++)
+		{
+			transforms.compute(affines.data());
+			checksum += affines[repeat % size].m[0];
+		}
+		double storeMilliseconds = benchMilliseconds(start);
+
+		double matrices = (double)size * repeats;
+		std::cout << "transforms, " << size << " objects, million matrices/s:\n"
+			<< "  glm translate/rotate/scale: " << matrices / glmMilliseconds / 1000.0 << "\n"
+			<< "  TransformStore::compute:    " << matrices / storeMilliseconds / 1000.0 << std::endl;
+	}
+	std::cout << "(checksum " << checksum << ")" << std::endl;
+}
+
+// names of the files in directory, without the path
+std::vector<std::string> benchListDirectory(const std::string& directory)
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	_finddata_t file;
+	intptr_t search = _findfirst((directory + "\\*").c_str(), &file);
+	if (search == -1)
+		return names;
+	do
+	{
+		if (!(file.attrib & _A_SUBDIR))
+			names.push_back(file.name);
+	} while (_findnext(search, &file) == 0);
+	_findclose(search);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return names;
+	while (dirent* file = readdir(dir))
+	{
+		if (file->d_type == DT_REG)
+			names.push_back(file->d_name);
+	}
+	closedir(dir);
+#endif
+	return names;
+}
+
+// RGBA of one BC1 or BC3 block as the GPU decodes it, row by row
+void benchDecodeBlock(const unsigned char* block, BlockFormat format, unsigned char texels[64])
+{
+	int alpha[8] = { 255, 255, 255, 255, 255, 255, 255, 255 };
+	uint64_t alphaIndices = 0;
+	if (format == BlockFormat::BC3)
+	{
+		alpha[0] = block[0];
+		alpha[1] = block[1];
+		if (alpha[0] > alpha[1])
+		{
+			for (int entry = 2; entry < 8; entry++)
+				alpha[entry] = ((8 - entry) * alpha[0] + (entry - 1) * alpha[1]) / 7;
+		}
+		else
+		{
+			for (int entry = 2; entry < 6; entry++)
+				alpha[entry] = ((6 - entry) * alpha[0] + (entry - 1) * alpha[1]) / 5;
+			alpha[6] = 0;
+			alpha[7] = 255;
+		}
+		for (int i = 0; i < 6; i++)
+			alphaIndices |= (uint64_t)block[2 + i] << (8 * i);
+		block += 8;
+	}
+
+	uint16_t colour0 = (uint16_t)(block[0] | block[1] << 8);
+	uint16_t colour1 = (uint16_t)(block[2] | block[3] << 8);
+	int palette[4][3];
+	unpackRGB565(colour0, palette[0]);
+	unpackRGB565(colour1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		// BC1 with colour0 <= colour1 is the 3 colour + transparent mode
+		if (colour0 > colour1 || format == BlockFormat::BC3)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+	for (int i = 0; i < 16; i++)
+	{
+		int entry = (indices >> (2 * i)) & 3;
+		for (int c = 0; c < 3; c++)
+			texels[i * 4 + c] = (unsigned char)palette[entry][c];
+		texels[i * 4 + 3] = (unsigned char)(format == BlockFormat::BC1 && colour0 <= colour1 && entry == 3
+			? 0 : alpha[(alphaIndices >> (3 * i)) & 7]);
+	}
+}
+
+// compressMipChain over every image in directory, in the format the
+// TextureStreamer would pick for it (BC3 with alpha, BC1 without). reports
+// MB/s of RGBA input (the top level) and the PSNR of the top level against
+// the original, over the channels the format keeps
+void benchCompression(const std::string& directory)
+{
+	const int REPEATS = 5;
+	std::cout << "block compression of " << directory << ":" << std::endl;
+	for (const std::string& name : benchListDirectory(directory))
+	{
+		int width, height, nrChannels;
+		unsigned char* rgba = stbi_load((directory + "/" + name).c_str(), &width, &height, &nrChannels, 4);
+		if (!rgba)
+			continue; // not an image
+		BlockFormat format = nrChannels == 2 || nrChannels == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+
+		std::vector<unsigned char> blocks;
+		BenchClock::time_point start = BenchClock::now();
+		for (int repeat = 0; repeat < REPEATS; repeat++)
+			blocks = compressMipChain(rgba, width, height, format);
+		double milliseconds = benchMilliseconds(start) / REPEATS;
+
+		// the top level comes first in the chain
+		int channels = format == BlockFormat::BC3 ? 4 : 3;
+		double squaredError = 0.0;
+		const unsigned char* block = blocks.data();
+		unsigned char texels[64];
+		for (int blockY = 0; blockY < height; blockY += 4)
+		{
+			for (int blockX = 0; blockX < width; blockX += 4)
+			{
+				benchDecodeBlock(block, format, texels);
+				block += blockBytes(format);
+				for (int y = blockY; y < blockY + 4 && y < height; y++)
+				{
+					for (int x = blockX; x < blockX + 4 && x < width; x++)
+					{
+						for (int c = 0; c < channels; c++)
+						{
+							double d = texels[((y - blockY) * 4 + x - blockX) * 4 + c] - rgba[(y * width + x) * 4 + c];
+							squaredError += d * d;
+						}
+					}
+				}
+			}
+		}
+		double meanSquaredError = squaredError / ((double)width * height * channels);
+		double psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+		stbi_image_free(rgba);
+
+		std::cout << "  " << name << " " << width << "x" << height
+			<< (format == BlockFormat::BC3 ? " BC3: " : " BC1: ")
+			<< (double)width * height * 4 / 1e3 / milliseconds << " MB/s, "
+			<< psnr << " dB PSNR" << std::endl;
+	}
+}
+
+#endif
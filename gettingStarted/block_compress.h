@@ -0,0 +1,364 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESS_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// CPU encoder for the S3TC block formats, 4x4 texels per block:
+// BC1 (DXT1) 8 bytes, RGB, 4 bits a texel
+// BC3 (DXT5) 16 bytes, RGBA, 8 bits a texel
+// the input is RGBA8 rows as decoded by stb_image with 4 channels.
+// the endpoints are the extremes along the block's main colour axis, which
+// is fast and looks fine for photos and flat art, not the best possible fit.
+// the nearest palette entry of every texel is searched 4 (colour) or 8
+// (alpha) texels at a time with SSE2, same indices as the scalar search
+enum class BlockFormat { BC1, BC3 };
+
+int blockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+// one mip level, partial blocks at the edges count as whole ones
+size_t blockLevelBytes(int width, int height, BlockFormat format)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// the full mip chain down to 1x1
+size_t blockChainBytes(int width, int height, BlockFormat format)
+{
+	size_t bytes = blockLevelBytes(width, height, format);
+	while (width > 1 || height > 1)
+	{
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		bytes += blockLevelBytes(width, height, format);
+	}
+	return bytes;
+}
+
+uint16_t packRGB565(const float colour[3])
+{
+	int r = (int)(colour[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(colour[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(colour[2] * 31.0f / 255.0f + 0.5f);
+	r = r < 0 ? 0 : (r > 31 ? 31 : r);
+	g = g < 0 ? 0 : (g > 63 ? 63 : g);
+	b = b < 0 ? 0 : (b > 31 ? 31 : b);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// as the GPU expands it, top bits repeated into the low ones
+void unpackRGB565(uint16_t packed, int colour[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	colour[0] = (r << 3) | (r >> 2);
+	colour[1] = (g << 2) | (g >> 4);
+	colour[2] = (b << 3) | (b >> 2);
+}
+
+// 2 bits per texel: the nearest of the 4 colours, the first one on a tie
+uint32_t fitColourIndices(const unsigned char* texels, const int palette[4][3])
+{
+	uint32_t indices = 0;
+#ifdef BLOCK_COMPRESS_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (int group = 0; group < 4; group++)
+	{
+		// 4 texels, one per register, transposed to R, G, B (and A) of all 4
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(texels + group * 16));
+		__m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+		__m128 r = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+		__m128 g = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+		__m128 b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+		__m128 a = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+
+		// the distances are whole numbers below 2^24, exact in floats
+		__m128 bestError = _mm_set1_ps(3.4e38f);
+		__m128i best = zero;
+		for (int entry = 0; entry < 4; entry++)
+		{
+			__m128 dr = _mm_sub_ps(r, _mm_set1_ps((float)palette[entry][0]));
+			__m128 dg = _mm_sub_ps(g, _mm_set1_ps((float)palette[entry][1]));
+			__m128 db = _mm_sub_ps(b, _mm_set1_ps((float)palette[entry][2]));
+			__m128 error = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+			__m128i better = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+			bestError = _mm_min_ps(error, bestError);
+			best = _mm_or_si128(_mm_andnot_si128(better, best), _mm_and_si128(better, _mm_set1_epi32(entry)));
+		}
+		int lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, best);
+		for (int i = 0; i < 4; i++)
+			indices |= (uint32_t)lanes[i] << (2 * (group * 4 + i));
+	}
+#else
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestError = 0;
+		for (int entry = 0; entry < 4; entry++)
+		{
+			int error = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				int d = texels[i * 4 + c] - palette[entry][c];
+				error += d * d;
+			}
+			if (entry == 0 || error < bestError)
+			{
+				bestError = error;
+				best = entry;
+			}
+		}
+		indices |= (uint32_t)best << (2 * i);
+	}
+#endif
+	return indices;
+}
+
+// 3 bits per texel: the nearest of the 8 alphas, the first one on a tie
+uint64_t fitAlphaIndices(const unsigned char* texels, const int palette[8])
+{
+	uint64_t indices = 0;
+#ifdef BLOCK_COMPRESS_SSE2
+	// alpha is the top byte of each texel, 8 of them as 16-bit lanes per half
+	__m128i alphas[2];
+	for (int half = 0; half < 2; half++)
+	{
+		__m128i first = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(texels + half * 32)), 24);
+		__m128i second = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(texels + half * 32 + 16)), 24);
+		alphas[half] = _mm_packs_epi32(first, second);
+	}
+	for (int half = 0; half < 2; half++)
+	{
+		__m128i bestError = _mm_set1_epi16(0x7fff);
+		__m128i best = _mm_setzero_si128();
+		for (int entry = 0; entry < 8; entry++)
+		{
+			__m128i value = _mm_set1_epi16((short)palette[entry]);
+			__m128i error = _mm_max_epi16(_mm_sub_epi16(alphas[half], value), _mm_sub_epi16(value, alphas[half]));
+			__m128i better = _mm_cmplt_epi16(error, bestError);
+			bestError = _mm_min_epi16(error, bestError);
+			best = _mm_or_si128(_mm_andnot_si128(better, best), _mm_and_si128(better, _mm_set1_epi16((short)entry)));
+		}
+		short lanes[8];
+		_mm_storeu_si128((__m128i*)lanes, best);
+		for (int i = 0; i < 8; i++)
+			indices |= (uint64_t)lanes[i] << (3 * (half * 8 + i));
+	}
+#else
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestError = 256;
+		for (int entry = 0; entry < 8; entry++)
+		{
+			int error = std::abs(texels[i * 4 + 3] - palette[entry]);
+			if (error < bestError)
+			{
+				bestError = error;
+				best = entry;
+			}
+		}
+		indices |= (uint64_t)best << (3 * i);
+	}
+#endif
+	return indices;
+}
+
+// the colour half of a block, always in 4 colour mode (colour0 > colour1)
+void encodeColourBlock(const unsigned char* texels, unsigned char* out)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			mean[c] += texels[i * 4 + c];
+	}
+	for (int c = 0; c < 3; c++)
+		mean[c] /= 16.0f;
+
+	// covariance: xx, xy, xz, yy, yz, zz
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float r = texels[i * 4] - mean[0], g = texels[i * 4 + 1] - mean[1], b = texels[i * 4 + 2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	// main axis by a few power iterations, from the grey diagonal
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; iteration++)
+	{
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float largest = std::fmax(std::fabs(x), std::fmax(std::fabs(y), std::fabs(z)));
+		if (largest == 0.0f)
+			break; // one flat colour, any axis does
+		axis[0] = x / largest; axis[1] = y / largest; axis[2] = z / largest;
+	}
+
+	int lowest = 0, highest = 0;
+	float lowestDot = 0.0f, highestDot = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float dot = texels[i * 4] * axis[0] + texels[i * 4 + 1] * axis[1] + texels[i * 4 + 2] * axis[2];
+		if (i == 0 || dot < lowestDot) { lowestDot = dot; lowest = i; }
+		if (i == 0 || dot > highestDot) { highestDot = dot; highest = i; }
+	}
+
+	// pulled in by 1/16 of the range, the extremes are rarely worth an endpoint
+	float high[3], low[3];
+	for (int c = 0; c < 3; c++)
+	{
+		float inset = (texels[highest * 4 + c] - texels[lowest * 4 + c]) / 16.0f;
+		high[c] = texels[highest * 4 + c] - inset;
+		low[c] = texels[lowest * 4 + c] + inset;
+	}
+	uint16_t colour0 = packRGB565(high), colour1 = packRGB565(low);
+	if (colour0 < colour1)
+	{
+		uint16_t swap = colour0;
+		colour0 = colour1;
+		colour1 = swap;
+	}
+
+	uint32_t indices = 0;
+	if (colour0 != colour1)
+	{
+		int palette[4][3];
+		unpackRGB565(colour0, palette[0]);
+		unpackRGB565(colour1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		indices = fitColourIndices(texels, palette);
+	}
+
+	out[0] = (unsigned char)(colour0 & 0xff); out[1] = (unsigned char)(colour0 >> 8);
+	out[2] = (unsigned char)(colour1 & 0xff); out[3] = (unsigned char)(colour1 >> 8);
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// the alpha half of a BC3 block, in 8 value mode (alpha0 > alpha1)
+void encodeAlphaBlock(const unsigned char* texels, unsigned char* out)
+{
+	int alpha0 = 0, alpha1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		int alpha = texels[i * 4 + 3];
+		alpha0 = alpha > alpha0 ? alpha : alpha0;
+		alpha1 = alpha < alpha1 ? alpha : alpha1;
+	}
+
+	uint64_t indices = 0;
+	if (alpha0 != alpha1)
+	{
+		int palette[8] = { alpha0, alpha1 };
+		for (int entry = 2; entry < 8; entry++)
+			palette[entry] = ((8 - entry) * alpha0 + (entry - 1) * alpha1) / 7;
+		indices = fitAlphaIndices(texels, palette);
+	}
+	else
+	{
+		alpha1 = alpha0; // index 0 everywhere
+	}
+
+	out[0] = (unsigned char)alpha0;
+	out[1] = (unsigned char)alpha1;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// one level, blocks left to right then top to bottom as GL expects them
+void compressLevel(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out)
+{
+	unsigned char texels[16 * 4];
+	for (int blockY = 0; blockY < height; blockY += 4)
+	{
+		for (int blockX = 0; blockX < width; blockX += 4)
+		{
+			// partial blocks repeat the edge texels
+			for (int y = 0; y < 4; y++)
+			{
+				int sourceY = blockY + y < height ? blockY + y : height - 1;
+				for (int x = 0; x < 4; x++)
+				{
+					int sourceX = blockX + x < width ? blockX + x : width - 1;
+					memcpy(texels + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+				}
+			}
+			if (format == BlockFormat::BC3)
+			{
+				encodeAlphaBlock(texels, out);
+				out += 8;
+			}
+			encodeColourBlock(texels, out);
+			out += 8;
+		}
+	}
+}
+
+// next mip level: 2x2 box filter down to the floor of half the size, as
+// glGenerateMipmap does, so an odd size drops its last row/column. an axis
+// that's already 1 stays 1, its single row/column averaged with itself
+void downsampleRGBA(const unsigned char* source, int width, int height, unsigned char* target)
+{
+	int targetWidth = width > 1 ? width / 2 : 1;
+	int targetHeight = height > 1 ? height / 2 : 1;
+	for (int y = 0; y < targetHeight; y++)
+	{
+		int y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+		for (int x = 0; x < targetWidth; x++)
+		{
+			int x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c] +
+					source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+				target[((size_t)y * targetWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+// every level of the mip chain, largest first, blockChainBytes in total.
+// glGenerateMipmap can't fill compressed levels, so they're made here
+std::vector<unsigned char> compressMipChain(const unsigned char* rgba, int width, int height, BlockFormat format)
+{
+	std::vector<unsigned char> blocks(blockChainBytes(width, height, format));
+	std::vector<unsigned char> level, next;
+	unsigned char* out = blocks.data();
+	const unsigned char* pixels = rgba;
+	for (;;)
+	{
+		compressLevel(pixels, width, height, format, out);
+		out += blockLevelBytes(width, height, format);
+		if (width == 1 && height == 1)
+			break;
+		next.resize((size_t)(width > 1 ? width / 2 : 1) * (height > 1 ? height / 2 : 1) * 4);
+		downsampleRGBA(pixels, width, height, next.data());
+		level.swap(next);
+		pixels = level.data();
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return blocks;
+}
+
+#endif
@@ -0,0 +1,56 @@
+# generates embedded_shaders.h from Shaders/*.vert and Shaders/*.frag so a
+# packaged (EMBED_SHADERS) build needs no shader files at runtime.
+# run by the Release pre-build step, the output is not checked in
+param(
+    [string]$ShaderDir = (Join-Path $PSScriptRoot "Shaders"),
+    [string]$Output = (Join-Path $PSScriptRoot "embedded_shaders.h")
+)
+
+# inline #include "file" lines the same way ShaderSourceLoader does: relative
+# to the including file, every file at most once
+function Expand-Shader([string]$path, [System.Collections.Generic.HashSet[string]]$included) {
+    $full = [System.IO.Path]::GetFullPath($path)
+    if (-not $included.Add($full)) { return "" }
+    $dir = Split-Path $full -Parent
+    $builder = New-Object System.Text.StringBuilder
+    foreach ($line in [System.IO.File]::ReadAllLines($full)) {
+        if ($line -match '^\s*#include\s*"([^"]+)"') {
+            [void]$builder.Append((Expand-Shader (Join-Path $dir $Matches[1]) $included))
+        }
+        else {
+            [void]$builder.Append($line).Append("`n")
+        }
+    }
+    return $builder.ToString()
+}
+
+$out = New-Object System.Text.StringBuilder
+[void]$out.Append("// generated by embed_shaders.ps1 from Shaders/, do not edit`n")
+[void]$out.Append("#ifndef EMBEDDED_SHADERS_H`n#define EMBEDDED_SHADERS_H`n`n")
+[void]$out.Append("#include `"shader_source.h`"`n`n")
+
+$files = Get-ChildItem $ShaderDir -File | Where-Object { $_.Extension -in ".vert", ".frag" } | Sort-Object Name
+foreach ($file in $files) {
+    # shader.vert -> EMBEDDED_SHADER_VERT
+    $name = "EMBEDDED_" + ($file.Name.ToUpper() -replace "[^A-Z0-9]", "_")
+    $text = Expand-Shader $file.FullName (New-Object "System.Collections.Generic.HashSet[string]")
+
+    # MSVC caps a single string literal at 16KB, so emit adjacent raw literals
+    $chunks = @(for ($i = 0; $i -lt $text.Length; $i += 8192) {
+        $text.Substring($i, [Math]::Min(8192, $text.Length - $i))
+    })
+    if ($chunks.Count -eq 0) { $chunks = @("") }
+
+    [void]$out.Append("constexpr SourceView $($name){`n")
+    foreach ($chunk in $chunks) {
+        [void]$out.Append("`tR`"glsl(" + $chunk + ")glsl`"`n")
+    }
+    [void]$out.Append("};`n`n")
+}
+[void]$out.Append("#endif`n")
+
+# only touch the header when a shader changed, so it doesn't force a rebuild
+$content = $out.ToString()
+if (-not (Test-Path $Output) -or [System.IO.File]::ReadAllText($Output) -ne $content) {
+    [System.IO.File]::WriteAllText($Output, $content)
+}
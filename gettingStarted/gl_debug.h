@@ -0,0 +1,153 @@
+#ifndef GL_DEBUG_H
+#define GL_DEBUG_H
+
+#include <glad/glad.h>
+
+#include "gl_features.h"
+
+#include <iostream>
+
+
+// error handling - end program
+#define ASSERT(x) if (!(x)) __debugbreak() // for MSVC compiler
+
+// how GLCall finds errors:
+//  - debug builds on a debug context with GL 4.3/KHR_debug: the driver reports
+//    them to GLDebugOutput as they happen, GLCall only remembers where it was.
+//    glGetError isn't called at all, it makes many drivers sync
+//  - debug builds without it: glGetError around every call, end program and
+//    show line/file
+//  - release builds (NDEBUG): the bare call, nothing else
+//  - release builds with GL_CHECK_EVERY_N_FRAMES defined (e.g. 120): the
+//    glGetError check, but only in every Nth frame, and errors are only
+//    logged, a shipped build keeps running. needs GLDebugNewFrame()
+//#define GL_CHECK_EVERY_N_FRAMES 120
+
+// messages come in while the driver works, so the reported call site is the
+// last GLCall before it. defining this makes them come in during the call
+// itself, for exact sites and breakpoints, at some speed cost
+//#define GL_DEBUG_SYNCHRONOUS
+
+#if defined(NDEBUG) && !defined(GL_CHECK_EVERY_N_FRAMES)
+#define GLCall(x) x
+#elif defined(NDEBUG)
+#define GLCall(x) do {\
+    if (GLCheckCall(#x, __FILE__, __LINE__)) {\
+        GLClearError();\
+        x;\
+        GLLogCall(#x, __FILE__, __LINE__);\
+    } else {\
+        x;\
+    }\
+} while (0)
+#else
+#define GLCall(x) do {\
+    if (GLCheckCall(#x, __FILE__, __LINE__)) {\
+        GLClearError();\
+        x;\
+        ASSERT(GLLogCall(#x, __FILE__, __LINE__)); /* # changes to string */\
+    } else {\
+        x;\
+    }\
+} while (0)
+#endif
+
+
+struct GLCallSite {
+	const char* function;
+	const char* file;
+	int line;
+};
+
+struct GLDebugState {
+	bool debugOutput;         // GLDebugOutput is receiving the errors
+	unsigned long long frame; // counted by GLDebugNewFrame
+	GLCallSite lastCall;
+};
+
+GLDebugState& GLGetDebugState()
+{
+	static GLDebugState state{ false, 0, { "(none)", "", 0 } };
+	return state;
+}
+
+// installs GLDebugOutput when the context supports it, call once after glad
+// is loaded. returns whether it did
+bool GLDebugSetup();
+
+// call once per frame, drives GL_CHECK_EVERY_N_FRAMES
+void GLDebugNewFrame()
+{
+	GLGetDebugState().frame++;
+}
+
+// remembers the call site, returns whether GLCall has to poll glGetError
+bool GLCheckCall(const char* function, const char* file, int line)
+{
+	GLDebugState& state = GLGetDebugState();
+	state.lastCall = GLCallSite{ function, file, line };
+	if (state.debugOutput)
+		return false;
+#ifdef GL_CHECK_EVERY_N_FRAMES
+	return state.frame % GL_CHECK_EVERY_N_FRAMES == 0;
+#else
+	return true;
+#endif
+}
+
+void GLClearError() {
+	while (glGetError() != GL_NO_ERROR); // 0 or GL_NO_ERROR
+}
+
+bool GLLogCall(const char* function, const char* file, int line) {
+	bool isError = true;
+	while (GLenum error = glGetError()) {
+		isError = false;
+		std::cout << "[OpenGL Error]" << "(" << error << "): " << function
+			<< " " << file << ": " << line << std::endl;
+	}
+	return isError;
+}
+
+#ifdef HAVE_GL_DEBUG_OUTPUT
+
+void APIENTRY GLDebugOutput(GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar* message, const void* userParam)
+{
+	const GLCallSite& site = GLGetDebugState().lastCall;
+	std::cout << "[OpenGL Debug]" << "(" << id << "): " << message << "\n"
+		<< "  last GLCall: " << site.function << " " << site.file << ": " << site.line << std::endl;
+#ifndef NDEBUG
+	ASSERT(type != GL_DEBUG_TYPE_ERROR);
+#endif
+}
+
+#endif
+
+bool GLDebugSetup()
+{
+#ifdef HAVE_GL_DEBUG_OUTPUT
+	if (!GLHasDebugOutput())
+		return false;
+	// without a debug context the driver may not report anything
+	int flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+		return false;
+
+	glEnable(GL_DEBUG_OUTPUT);
+#ifdef GL_DEBUG_SYNCHRONOUS
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+	glDebugMessageCallback(GLDebugOutput, NULL);
+	// everything but the chatty notifications (buffer placement etc.)
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION,
+		0, NULL, GL_FALSE);
+	GLGetDebugState().debugOutput = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef GL_FEATURES_H
+#define GL_FEATURES_H
+
+#include <glad/glad.h>
+
+// optional GL features. a GLAD_GL_* flag only exists when glad was generated
+// with that version/extension, so every check needs the header macro too
+
+
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_get_program_binary)
+#define HAVE_GL_PROGRAM_BINARY 1
+#endif
+
+#ifdef GL_KHR_parallel_shader_compile
+#define HAVE_GL_PARALLEL_SHADER_COMPILE 1
+#endif
+
+#if defined(GL_VERSION_4_1) || defined(GL_ARB_separate_shader_objects)
+#define HAVE_GL_SEPARATE_SHADER_OBJECTS 1
+#endif
+
+#if defined(GL_VERSION_4_4) || defined(GL_ARB_buffer_storage)
+#define HAVE_GL_BUFFER_STORAGE 1
+#endif
+
+#if defined(GL_VERSION_4_3) || defined(GL_KHR_debug)
+#define HAVE_GL_DEBUG_OUTPUT 1
+#endif
+
+#if defined(GL_VERSION_4_2) || defined(GL_ARB_texture_storage)
+#define HAVE_GL_TEXTURE_STORAGE 1
+#endif
+
+#ifdef GL_EXT_texture_compression_s3tc
+#define HAVE_GL_TEXTURE_COMPRESSION_S3TC 1
+#endif
+
+
+// glGetProgramBinary/glProgramBinary and at least one binary format
+bool GLHasProgramBinary()
+{
+	bool supported = false;
+#ifdef GL_VERSION_4_1
+	supported = supported || GLAD_GL_VERSION_4_1;
+#endif
+#ifdef GL_ARB_get_program_binary
+	supported = supported || GLAD_GL_ARB_get_program_binary;
+#endif
+	if (!supported)
+		return false;
+
+	int formats = 0;
+#ifdef HAVE_GL_PROGRAM_BINARY
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+#endif
+	return formats > 0;
+}
+
+// GL_COMPLETION_STATUS_KHR and driver side compiler threads
+bool GLHasParallelShaderCompile()
+{
+#ifdef HAVE_GL_PARALLEL_SHADER_COMPILE
+	return GLAD_GL_KHR_parallel_shader_compile != 0;
+#else
+	return false;
+#endif
+}
+
+// GL_PROGRAM_SEPARABLE, program pipelines and glProgramUniform*
+bool GLHasSeparateShaderObjects()
+{
+	bool supported = false;
+#ifdef GL_VERSION_4_1
+	supported = supported || GLAD_GL_VERSION_4_1;
+#endif
+#ifdef GL_ARB_separate_shader_objects
+	supported = supported || GLAD_GL_ARB_separate_shader_objects;
+#endif
+	return supported;
+}
+
+// immutable textures with glTexStorage*
+bool GLHasTextureStorage()
+{
+	bool supported = false;
+#ifdef GL_VERSION_4_2
+	supported = supported || GLAD_GL_VERSION_4_2;
+#endif
+#ifdef GL_ARB_texture_storage
+	supported = supported || GLAD_GL_ARB_texture_storage;
+#endif
+	return supported;
+}
+
+// DXT1/DXT5 (BC1/BC3) textures, not core in any version
+bool GLHasTextureCompressionS3TC()
+{
+#ifdef HAVE_GL_TEXTURE_COMPRESSION_S3TC
+	return GLAD_GL_EXT_texture_compression_s3tc != 0;
+#else
+	return false;
+#endif
+}
+
+// glDebugMessageCallback and GL_DEBUG_OUTPUT
+bool GLHasDebugOutput()
+{
+	bool supported = false;
+#ifdef GL_VERSION_4_3
+	supported = supported || GLAD_GL_VERSION_4_3;
+#endif
+#ifdef GL_KHR_debug
+	supported = supported || GLAD_GL_KHR_debug;
+#endif
+	return supported;
+}
+
+// immutable buffers with glBufferStorage, and persistently mapped ones
+bool GLHasBufferStorage()
+{
+	bool supported = false;
+#ifdef GL_VERSION_4_4
+	supported = supported || GLAD_GL_VERSION_4_4;
+#endif
+#ifdef GL_ARB_buffer_storage
+	supported = supported || GLAD_GL_ARB_buffer_storage;
+#endif
+	return supported;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+
+// shadow copy of the main context's bindings: textures per unit, the program,
+// the VAO and buffers. a bind to what is already bound is dropped instead of
+// reaching the driver. only correct if every bind of the cached kinds goes
+// through here, so call invalidate() after code that binds directly, and the
+// forget* functions after deleting objects (their names get reused).
+// state of the main context only, don't use it from the reload worker
+class GLStateCache {
+public:
+	struct Stats {
+		unsigned int issued; // calls that reached GL
+		unsigned int elided; // calls dropped because nothing changed
+	};
+
+	static constexpr unsigned int MAX_TEXTURE_UNITS = 32;
+
+	static GLStateCache& get();
+
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vertexArray);
+	void bindBuffer(GLenum target, unsigned int buffer);
+	// always issued, also sets the generic binding of target
+	void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+
+	// deleting a bound object unbinds it
+	void forgetTexture(unsigned int texture);
+	void forgetBuffer(unsigned int buffer);
+	void forgetVertexArray(unsigned int vertexArray);
+
+	// everything unknown, the next bind of each is issued
+	void invalidate();
+
+	// call once per frame: moves the counts to lastFrameStats
+	void beginFrame();
+	const Stats& lastFrameStats() const { return lastFrame; }
+	const Stats& frameStats() const { return frame; }
+
+private:
+	static constexpr unsigned int UNKNOWN = ~0u;
+	static constexpr int TEXTURE_TARGETS = 4;
+	static constexpr int BUFFER_TARGETS = 5;
+
+	unsigned int activeUnit;
+	unsigned int textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int buffers[BUFFER_TARGETS];
+	Stats frame, lastFrame;
+
+	GLStateCache();
+	// slot in the arrays above, -1 for targets that aren't cached
+	static int textureTargetIndex(GLenum target);
+	static int bufferTargetIndex(GLenum target);
+	// true when the call can be dropped, and counts it
+	bool same(unsigned int& shadow, unsigned int value);
+};
+
+GLStateCache& GLStateCache::get()
+{
+	static GLStateCache cache;
+	return cache;
+}
+
+GLStateCache::GLStateCache() : frame{ 0, 0 }, lastFrame{ 0, 0 }
+{
+	invalidate();
+}
+
+bool GLStateCache::same(unsigned int& shadow, unsigned int value)
+{
+	if (shadow == value)
+	{
+		frame.elided++;
+		return true;
+	}
+	shadow = value;
+	frame.issued++;
+	return false;
+}
+
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture)
+{
+	int index = textureTargetIndex(target);
+	if (index < 0 || unit >= MAX_TEXTURE_UNITS)
+	{
+		// not cached, but it may still change the active unit
+		if (!same(activeUnit, unit))
+			glActiveTexture(GL_TEXTURE0 + unit);
+		frame.issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (textures[unit][index] == texture)
+	{
+		frame.elided++;
+		return;
+	}
+	if (!same(activeUnit, unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+	same(textures[unit][index], texture);
+	glBindTexture(target, texture);
+}
+
+void GLStateCache::useProgram(unsigned int program)
+{
+	if (!same(this->program, program))
+		glUseProgram(program);
+}
+
+void GLStateCache::bindVertexArray(unsigned int vertexArray)
+{
+	if (same(this->vertexArray, vertexArray))
+		return;
+	glBindVertexArray(vertexArray);
+	// the element array binding belongs to the VAO
+	buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer)
+{
+	int index = bufferTargetIndex(target);
+	if (index < 0)
+	{
+		frame.issued++;
+		glBindBuffer(target, buffer);
+	}
+	else if (!same(buffers[index], buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLStateCache::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+{
+	frame.issued++;
+	glBindBufferBase(target, index, buffer);
+	int slot = bufferTargetIndex(target);
+	if (slot >= 0)
+		buffers[slot] = buffer;
+}
+
+void GLStateCache::forgetTexture(unsigned int texture)
+{
+	for (auto& unit : textures)
+	{
+		for (unsigned int& bound : unit)
+		{
+			if (bound == texture)
+				bound = 0;
+		}
+	}
+}
+
+void GLStateCache::forgetBuffer(unsigned int buffer)
+{
+	for (unsigned int& bound : buffers)
+	{
+		if (bound == buffer)
+			bound = 0;
+	}
+}
+
+void GLStateCache::forgetVertexArray(unsigned int vertexArray)
+{
+	if (this->vertexArray == vertexArray)
+	{
+		this->vertexArray = 0;
+		buffers[bufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+	}
+}
+
+void GLStateCache::invalidate()
+{
+	activeUnit = UNKNOWN;
+	for (auto& unit : textures)
+	{
+		for (unsigned int& bound : unit)
+			bound = UNKNOWN;
+	}
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	for (unsigned int& bound : buffers)
+		bound = UNKNOWN;
+}
+
+void GLStateCache::beginFrame()
+{
+	lastFrame = frame;
+	frame = Stats{ 0, 0 };
+}
+
+int GLStateCache::textureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_CUBE_MAP: return 2;
+	case GL_TEXTURE_3D: return 3;
+	default: return -1;
+	}
+}
+
+int GLStateCache::bufferTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_ELEMENT_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_PIXEL_UNPACK_BUFFER: return 3;
+	case GL_PIXEL_PACK_BUFFER: return 4;
+	default: return -1;
+	}
+}
+
+#endif
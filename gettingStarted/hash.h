@@ -0,0 +1,20 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+
+// 64-bit FNV-1a, continued from a previous hash
+constexpr uint64_t hashBytes(uint64_t hash, const char* data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+constexpr uint64_t HASH_BYTES_SEED = 14695981039346656037ull;
+
+#endif
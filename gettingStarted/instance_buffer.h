@@ -0,0 +1,107 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "stream_buffer.h"
+
+#include <cstddef>
+#include <cstring>
+
+
+// how one instance of T is fed to the vertex shader. specialize it for every
+// type stored in an InstanceBuffer
+template <typename T> struct InstanceAttributes;
+
+// a mat4 takes four vec4 attribute locations, one per column
+template <> struct InstanceAttributes<glm::mat4> {
+	static constexpr unsigned int locationCount = 4;
+	static void point(unsigned int location, size_t offset)
+	{
+		for (unsigned int i = 0; i < 4; i++)
+			glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+				(void*)(offset + i * sizeof(glm::vec4)));
+	}
+};
+
+
+// per-instance data in a vertex buffer (attribute divisor 1), so any number
+// of instances goes out in one glDrawElementsInstanced. the data streams
+// through a StreamBuffer, so the attributes are pointed at the region
+// written this frame; keep the VAO the buffer was made with bound
+template <typename T>
+class InstanceBuffer {
+public:
+	size_t count;    // instances in the last upload
+	size_t capacity; // instances the buffer can hold
+
+	// adds the instance attributes, starting at location, to the bound VAO
+	InstanceBuffer(unsigned int location, size_t capacity = 1024);
+
+	// replaces the contents, doubling the buffer when it's too small
+	void upload(const T* instances, size_t count);
+
+	// same, but count instances are written straight into the buffer, e.g. by
+	// TransformStore::compute. call unmap() before drawing, but only when this
+	// didn't return null; then count is 0 so nothing stale gets drawn
+	T* map(size_t count);
+	void unmap();
+
+	unsigned int bufferID() const { return stream.ID; }
+	void release() { stream.release(); }
+
+private:
+	unsigned int location;
+	StreamBuffer stream;
+};
+
+template <typename T>
+InstanceBuffer<T>::InstanceBuffer(unsigned int location, size_t capacity)
+	: count(0), capacity(capacity ? capacity : 1), location(location),
+	stream(GL_ARRAY_BUFFER, this->capacity * sizeof(T))
+{
+	GLStateCache::get().bindBuffer(GL_ARRAY_BUFFER, stream.ID);
+	InstanceAttributes<T>::point(location, 0);
+	for (unsigned int i = 0; i < InstanceAttributes<T>::locationCount; i++)
+	{
+		glEnableVertexAttribArray(location + i);
+		glVertexAttribDivisor(location + i, 1); // advance once per instance
+	}
+}
+
+template <typename T>
+void InstanceBuffer<T>::upload(const T* instances, size_t count)
+{
+	if (T* mapped = map(count))
+	{
+		memcpy(mapped, instances, count * sizeof(T));
+		unmap();
+	}
+}
+
+template <typename T>
+T* InstanceBuffer<T>::map(size_t count)
+{
+	if (this->capacity < count)
+	{
+		while (this->capacity < count)
+			this->capacity *= 2;
+		stream.resize(this->capacity * sizeof(T));
+	}
+	T* mapped = (T*)stream.begin();
+	this->count = mapped ? count : 0;
+	return mapped;
+}
+
+template <typename T>
+void InstanceBuffer<T>::unmap()
+{
+	size_t offset = stream.end();
+	// the attributes keep the buffer bound when they were pointed, so this
+	// also picks up a buffer recreated by resize()
+	GLStateCache::get().bindBuffer(GL_ARRAY_BUFFER, stream.ID);
+	InstanceAttributes<T>::point(this->location, offset);
+}
+
+#endif
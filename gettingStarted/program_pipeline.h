@@ -0,0 +1,122 @@
+#ifndef PROGRAM_PIPELINE_H
+#define PROGRAM_PIPELINE_H
+
+#include <glad/glad.h>
+
+#include "gl_features.h"
+#include "gl_state.h"
+#include "shader.h"
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+
+// combines separable stage programs at bind time, nothing is relinked.
+// needs GL 4.1 or ARB_separate_shader_objects
+class ProgramPipeline {
+public:
+	unsigned int ID;
+
+	ProgramPipeline(const Shader& vertexStage, const Shader& fragmentStage);
+
+	// a program bound with glUseProgram wins over the pipeline, so unbind it
+	void bind() const;
+
+	// glUniform* go to this stage's program. the Shader setters only need
+	// this when they can't use glProgramUniform* (no GL 4.1/ARB_sso)
+	void setActiveStage(const Shader& stage) const;
+};
+
+ProgramPipeline::ProgramPipeline(const Shader& vertexStage, const Shader& fragmentStage)
+	: ID(0)
+{
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	if (!GLHasSeparateShaderObjects())
+		return;
+	glGenProgramPipelines(1, &this->ID);
+	glUseProgramStages(this->ID, GL_VERTEX_SHADER_BIT, vertexStage.ID);
+	glUseProgramStages(this->ID, GL_FRAGMENT_SHADER_BIT, fragmentStage.ID);
+#endif
+}
+
+void ProgramPipeline::bind() const
+{
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	GLStateCache::get().useProgram(0);
+	glBindProgramPipeline(this->ID);
+#endif
+}
+
+void ProgramPipeline::setActiveStage(const Shader& stage) const
+{
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	glActiveShaderProgram(this->ID, stage.ID);
+#endif
+}
+
+
+// owns stage programs and the pipelines made from them. every stage variant
+// is compiled once, so V vertex and F fragment variants cost V + F programs
+// instead of V * F linked ones. pipelines themselves are cheap to create
+class ShaderPipelines {
+public:
+	Shader& vertexStage(const char* path, const std::string& defines = std::string());
+	Shader& fragmentStage(const char* path, const std::string& defines = std::string());
+
+	ProgramPipeline& get(const Shader& vertexStage, const Shader& fragmentStage);
+
+	size_t programCount() const { return stages.size(); }
+
+	// deletes every stage program and pipeline
+	void release();
+
+private:
+	std::unordered_map<std::string, std::unique_ptr<Shader>> stages;
+	std::unordered_map<uint64_t, std::unique_ptr<ProgramPipeline>> pipelines;
+
+	Shader& stage(GLenum type, const char* path, const std::string& defines);
+};
+
+Shader& ShaderPipelines::vertexStage(const char* path, const std::string& defines)
+{
+	return stage(GL_VERTEX_SHADER, path, defines);
+}
+
+Shader& ShaderPipelines::fragmentStage(const char* path, const std::string& defines)
+{
+	return stage(GL_FRAGMENT_SHADER, path, defines);
+}
+
+Shader& ShaderPipelines::stage(GLenum type, const char* path, const std::string& defines)
+{
+	std::string key = std::to_string(type) + '|' + path + '|' + defines;
+	auto it = stages.find(key);
+	if (it != stages.end())
+		return *it->second;
+	return *(stages[key] = std::unique_ptr<Shader>(new Shader(type, path, defines)));
+}
+
+ProgramPipeline& ShaderPipelines::get(const Shader& vertexStage, const Shader& fragmentStage)
+{
+	uint64_t key = ((uint64_t)vertexStage.ID << 32) | fragmentStage.ID;
+	auto it = pipelines.find(key);
+	if (it != pipelines.end())
+		return *it->second;
+	return *(pipelines[key] = std::unique_ptr<ProgramPipeline>(
+		new ProgramPipeline(vertexStage, fragmentStage)));
+}
+
+void ShaderPipelines::release()
+{
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	for (auto& pipeline : pipelines)
+		glDeleteProgramPipelines(1, &pipeline.second->ID);
+#endif
+	for (auto& stage : stages)
+		glDeleteProgram(stage.second->ID);
+	pipelines.clear();
+	stages.clear();
+}
+
+#endif
@@ -2,11 +2,66 @@
 #define SHADER_H
 
 #include <glad/glad.h> // to get the required opengl headers
+#include "gl_features.h"
+#include "gl_state.h"
+#include "hash.h"
+#include "shader_source.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <string>
 #include <fstream>
-#include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+
+// 32-bit FNV-1a of a uniform name, keys the location table below
+constexpr uint32_t hashUniformName(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	while (*name)
+	{
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// handle to a uniform by name. UNIFORM("name") hashes the literal at compile
+// time in every build, so setting a uniform through it does no string work.
+// a plain literal or std::string is hashed when the call runs (an optimized
+// build may fold a literal's hash, a debug one won't).
+// debug builds also keep the name to check it against the uniform found, so
+// there an id made from a runtime string must not outlive that string
+#define UNIFORM(name) UniformId::fromHash(std::integral_constant<uint32_t, hashUniformName(name)>::value, name)
+
+struct UniformId {
+	uint32_t hash;
+#ifndef NDEBUG
+	const char* name;
+#endif
+
+	template <size_t N>
+	constexpr UniformId(const char (&name)[N]) : UniformId(hashUniformName(name), name) {}
+	UniformId(const std::string& name) : UniformId(hashUniformName(name.c_str()), name.c_str()) {}
+
+	// names only known at runtime, e.g. built with snprintf
+	static UniformId fromString(const char* name) { return UniformId(hashUniformName(name), name); }
+	// hash must be hashUniformName(name), use UNIFORM() rather than this
+	static constexpr UniformId fromHash(uint32_t hash, const char* name) { return UniformId(hash, name); }
+
+private:
+#ifndef NDEBUG
+	constexpr UniformId(uint32_t hash, const char* name) : hash(hash), name(name) {}
+#else
+	constexpr UniformId(uint32_t hash, const char*) : hash(hash) {}
+#endif
+};
 
 
 class Shader {
@@ -14,87 +69,237 @@ public:
 	// program id
 	unsigned int ID;
 
-	// ctor reads and builds the shader
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// ctor reads and builds the shader. defines ("#define NAME\n" lines) are
+	// inserted after #version in both stages
+	Shader(const char* vertexPath, const char* fragmentPath,
+		const std::string &defines = std::string());
+	// builds from sources already in memory (see embedded_shaders.h), no file I/O
+	Shader(SourceView vertexSource, SourceView fragmentSource,
+		const std::string &defines = std::string());
+	// a separable program of a single stage (GL_VERTEX_SHADER, ...) to be
+	// combined with others in a ProgramPipeline. SEPARABLE is defined for it
+	Shader(GLenum stage, const char* path, const std::string &defines = std::string());
 
 	// use/activate the shader
 	void use() const;
 
-	// utility uniform functions
-	void setBool(const std::string &name, bool value) const;
-	void setInt(const std::string &name, int value) const;
-	void setFloat(const std::string &name, float value) const;
-	// consider setMat4
+	// opt-in on-disk cache of linked program binaries, keyed by both sources
+	// and the GL vendor/renderer/version. the directory must already exist
+	static void enableBinaryCache(const std::string &directory);
+
+	// cached location of an active uniform, -1 if the program doesn't use it
+	int getUniformLocation(UniformId uniform) const;
+
+	// attach a uniform block to a binding point. if size is given, warns when
+	// the block needs more bytes than the C++ struct provides
+	void bindUniformBlock(const char* blockName, unsigned int binding, size_t size = 0) const;
+
+	// utility uniform functions. with GL 4.1/ARB_separate_shader_objects they
+	// write to this program directly (glProgramUniform*), otherwise the
+	// program has to be bound with use() first
+	void setBool(UniformId uniform, bool value) const;
+	void setInt(UniformId uniform, int value) const;
+	void setFloat(UniformId uniform, float value) const;
+	void setMat4(UniformId uniform, const glm::mat4 &value) const;
+
+	// the setters keep a copy of every value they send and skip the GL call
+	// when the new value is bit-identical. call invalidateUniforms() after
+	// setting uniforms on this program with raw glUniform* calls
+	struct UniformStats {
+		unsigned long long uploadsIssued = 0;
+		unsigned long long uploadsSkipped = 0;
+	};
+	const UniformStats& getUniformStats() const { return uniformStats; }
+	void resetUniformStats() const { uniformStats = UniformStats(); }
+	void invalidateUniforms();
+
+private:
+	friend class ShaderBuildQueue;
+	friend class ShaderHotReload;
+
+	// what a path-built shader was built from, empty for in-memory sources
+	std::string vertexPath, fragmentPath, defines;
+
+	// state carried between issuing a build and checking its result
+	struct PendingBuild {
+		unsigned int vertex = 0;
+		unsigned int fragment = 0;
+		bool useBinaryCache = false;
+		bool fromCache = false;
+		uint64_t cacheKey = 0;
+	};
+
+	Shader() : ID(0) {}
+	Shader(const ShaderSource &vertexSource, const ShaderSource &fragmentSource);
+	// exchange programs (and their uniform tables) with another shader
+	void swapProgram(Shader &other);
+	PendingBuild beginBuild(const ShaderSource &vertexSource, const ShaderSource &fragmentSource);
+	bool isBuildComplete(const PendingBuild &build) const;
+	void finishBuild(PendingBuild &build);
+	void buildSeparable(GLenum stage, const ShaderSource &source);
+
+	// open addressing table of active uniforms, filled once after linking.
+	// an empty slot has location -1 (inactive uniforms are never stored)
+	struct UniformSlot {
+		uint32_t hash;
+		int location;
+		uint32_t shadowOffset; // into shadowValues: a "set" byte, then the value
+		uint32_t shadowSize;
+#ifndef NDEBUG
+		std::string name; // to catch a different name with the same hash
+#endif
+	};
+	std::vector<UniformSlot> uniformTable;
+	uint32_t uniformMask = 0;
+	mutable std::vector<unsigned char> shadowValues;
+	mutable UniformStats uniformStats;
+
+	static std::string& binaryCacheDirectory();
+	static ShaderSourceLoader& sourceLoader();
+	static uint64_t hashSources(const ShaderSource &vertexSource, const ShaderSource &fragmentSource);
+	static uint64_t binaryCacheKey(const ShaderSource &vertexSource, const ShaderSource &fragmentSource);
+	static std::string binaryCachePath(uint64_t key);
+	bool loadProgramBinary(uint64_t key);
+	void saveProgramBinary(uint64_t key) const;
+
+	void buildUniformTable();
+	void insertUniform(const std::string &name, const UniformSlot &uniform);
+	const UniformSlot* findUniform(const UniformId &uniform) const;
+	bool needsUpload(UniformId uniform, const void* value, size_t size, int &location) const;
+	static uint32_t uniformTypeSize(GLenum type);
 };
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
-{
-	// 1. retrieve the vertex/fragment source code from filePath /////////////
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
-	{
-		// open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		// read files buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-	}
-	catch (std::ifstream::failure e)
-	{
-		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-	}
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+{
+	// retrieve the vertex/fragment source code from filePath
+	// (includes expanded, views into the shared loader cache, nothing copied)
+	ShaderSource vertex = sourceLoader().load(vertexPath);
+	ShaderSource fragment = sourceLoader().load(fragmentPath);
+	vertex.insertAfterVersion(defines.data(), defines.size());
+	fragment.insertAfterVersion(defines.data(), defines.size());
+	PendingBuild build = beginBuild(vertex, fragment);
+	finishBuild(build);
+}
+
+Shader::Shader(SourceView vertexSource, SourceView fragmentSource, const std::string& defines)
+{
+	ShaderSource vertex, fragment;
+	vertex.append(vertexSource);
+	fragment.append(fragmentSource);
+	vertex.insertAfterVersion(defines.data(), defines.size());
+	fragment.insertAfterVersion(defines.data(), defines.size());
+	PendingBuild build = beginBuild(vertex, fragment);
+	finishBuild(build);
+}
+
+Shader::Shader(GLenum stage, const char* path, const std::string& defines)
+{
+	ShaderSource source = sourceLoader().load(path);
+	std::string stageDefines = "#define SEPARABLE\n" + defines;
+	source.insertAfterVersion(stageDefines.data(), stageDefines.size());
+	buildSeparable(stage, source);
+}
+
+Shader::Shader(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+	PendingBuild build = beginBuild(vertexSource, fragmentSource);
+	finishBuild(build);
+}
+
+void Shader::swapProgram(Shader& other)
+{
+	std::swap(this->ID, other.ID);
+	std::swap(this->uniformTable, other.uniformTable);
+	std::swap(this->uniformMask, other.uniformMask);
+	std::swap(this->shadowValues, other.shadowValues);
+}
+
+// issue every GL call needed to build the program but query nothing, so the
+// driver is free to compile in the background until finishBuild()
+Shader::PendingBuild Shader::beginBuild(const ShaderSource& vertexSource,
+	const ShaderSource& fragmentSource)
+{
+	PendingBuild build;
+
+	// 1. skip compiling if the binary cache has this program /////////////
+	build.useBinaryCache = !binaryCacheDirectory().empty() && GLHasProgramBinary();
+	if (build.useBinaryCache)
+	{
+		build.cacheKey = binaryCacheKey(vertexSource, fragmentSource);
+		if (loadProgramBinary(build.cacheKey))
+		{
+			build.fromCache = true;
+			return build;
+		}
+	}
 
 	// 2. compile shaders ///////////////////////////////////
-	unsigned int vertex, fragment;
+	// vertex Shader
+	build.vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(build.vertex, vertexSource.count(), vertexSource.strings.data(),
+		vertexSource.lengths.data());
+	glCompileShader(build.vertex);
+
+	// fragment Shader
+	build.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragment, fragmentSource.count(), fragmentSource.strings.data(),
+		fragmentSource.lengths.data());
+	glCompileShader(build.fragment);
+
+	// create shader program ////////////////////////////////
+	this->ID = glCreateProgram();
+	glAttachShader(ID, build.vertex);
+	glAttachShader(ID, build.fragment);
+#ifdef HAVE_GL_PROGRAM_BINARY
+	if (build.useBinaryCache)
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+	glLinkProgram(ID);
+	return build;
+}
+
+// true once the driver has finished compiling/linking. without
+// KHR_parallel_shader_compile there's no way to ask, so finishBuild() may block
+bool Shader::isBuildComplete(const PendingBuild& build) const
+{
+#ifdef HAVE_GL_PARALLEL_SHADER_COMPILE
+	if (GLHasParallelShaderCompile())
+	{
+		int complete = GL_TRUE;
+		glGetProgramiv(this->ID, GL_COMPLETION_STATUS_KHR, &complete);
+		return complete == GL_TRUE;
+	}
+#endif
+	return true;
+}
+
+void Shader::finishBuild(PendingBuild& build)
+{
+	if (build.fromCache)
+	{
+		buildUniformTable();
+		return;
+	}
+
 	int success;
 	char infoLog[512];
-	// vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
 	// print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(build.vertex, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(build.vertex, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" <<
 			infoLog << std::endl;
 	};
-
-	// fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	// print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(build.fragment, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+		glGetShaderInfoLog(build.fragment, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" <<
 			infoLog << std::endl;
 	};
 
-	// create shader program ////////////////////////////////
-	this->ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
 	// print linking errors if any
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
 	if (!success)
@@ -103,26 +308,406 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" <<
 			infoLog << std::endl;
 	}
+	else if (build.useBinaryCache)
+	{
+		saveProgramBinary(build.cacheKey);
+	}
+	buildUniformTable();
+
 	// delete shaders; theyre linked into our program and no longer necessary
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(build.vertex);
+	glDeleteShader(build.fragment);
+	build.vertex = build.fragment = 0;
+}
+
+void Shader::buildSeparable(GLenum stage, const ShaderSource& source)
+{
+	this->ID = 0;
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	if (GLHasSeparateShaderObjects())
+	{
+		const char* stageName = stage == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
+		int success;
+		char infoLog[512];
+
+		unsigned int shader = glCreateShader(stage);
+		glShaderSource(shader, source.count(), source.strings.data(), source.lengths.data());
+		glCompileShader(shader);
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shader, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" <<
+				infoLog << std::endl;
+		}
+
+		this->ID = glCreateProgram();
+		glProgramParameteri(ID, GL_PROGRAM_SEPARABLE, GL_TRUE);
+		glAttachShader(ID, shader);
+		glLinkProgram(ID);
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(ID, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" <<
+				infoLog << std::endl;
+		}
+		glDetachShader(ID, shader);
+		glDeleteShader(shader);
+		buildUniformTable();
+		return;
+	}
+#endif
+	std::cout << "ERROR::SHADER::SEPARABLE_PROGRAMS_UNSUPPORTED" << std::endl;
 }
 
 void Shader::use() const {
-	glUseProgram(this->ID);
+	GLStateCache::get().useProgram(this->ID);
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::enableBinaryCache(const std::string& directory)
 {
-	glUniform1i(glGetUniformLocation(this->ID, name.c_str()), (int)value);
+	binaryCacheDirectory() = directory;
 }
-void Shader::setInt(const std::string& name, int value) const
+
+// shared by every shader so common includes are only read once
+ShaderSourceLoader& Shader::sourceLoader()
 {
-	glUniform1i(glGetUniformLocation(this->ID, name.c_str()), value);
+	static ShaderSourceLoader loader;
+	return loader;
 }
-void Shader::setFloat(const std::string& name, float value) const
+
+std::string& Shader::binaryCacheDirectory()
 {
-	glUniform1f(glGetUniformLocation(this->ID, name.c_str()), value);
+	static std::string directory;
+	return directory;
+}
+
+// hash of the text of both stages, as compiled
+uint64_t Shader::hashSources(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+	uint64_t hash = HASH_BYTES_SEED;
+	for (const ShaderSource* source : { &vertexSource, &fragmentSource })
+	{
+		for (GLsizei i = 0; i < source->count(); i++)
+			hash = hashBytes(hash, source->strings[i], source->lengths[i]);
+		hash = hashBytes(hash, "", 1); // separator, so moving text between the stages changes it
+	}
+	return hash;
+}
+
+// both sources plus the driver identification, so a driver update or a
+// different GPU never picks up a stale binary
+uint64_t Shader::binaryCacheKey(const ShaderSource& vertexSource, const ShaderSource& fragmentSource)
+{
+	uint64_t hash = hashSources(vertexSource, fragmentSource);
+	const GLenum driverStrings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : driverStrings)
+	{
+		const char* value = (const char*)glGetString(name);
+		if (value)
+			hash = hashBytes(hash, value, strlen(value) + 1); // with the terminator as a separator
+	}
+	return hash;
+}
+
+std::string Shader::binaryCachePath(uint64_t key)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bin", (unsigned long long)key);
+	return binaryCacheDirectory() + "/" + fileName;
+}
+
+// cache file layout: magic, binary format, key, length, then the binary
+struct ProgramBinaryHeader {
+	uint32_t magic;
+	uint32_t format;
+	uint64_t key;
+	uint32_t length;
+};
+constexpr uint32_t PROGRAM_BINARY_MAGIC = 0x42504c47; // "GLPB"
+
+bool Shader::loadProgramBinary(uint64_t key)
+{
+#ifdef HAVE_GL_PROGRAM_BINARY
+	std::ifstream file(binaryCachePath(key), std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0);
+
+	ProgramBinaryHeader header;
+	if (!file.read((char*)&header, sizeof(header)) ||
+		header.magic != PROGRAM_BINARY_MAGIC || header.key != key)
+		return false;
+	// a truncated or corrupt file must not size the allocation
+	if (header.length == 0 || (std::streamoff)header.length != fileSize - (std::streamoff)sizeof(header))
+		return false;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return false;
+
+	this->ID = glCreateProgram();
+	glProgramBinary(ID, header.format, binary.data(), (GLsizei)binary.size());
+	// the driver rejects binaries it can no longer use, fall back to compiling
+	int success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(ID);
+		return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Shader::saveProgramBinary(uint64_t key) const
+{
+#ifdef HAVE_GL_PROGRAM_BINARY
+	int length = 0;
+	glGetProgramiv(this->ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(this->ID, length, &length, &format, binary.data());
+
+	std::ofstream file(binaryCachePath(key), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::SHADER::BINARY_CACHE::WRITE_FAILED\n" <<
+			binaryCachePath(key) << std::endl;
+		return;
+	}
+	ProgramBinaryHeader header{ PROGRAM_BINARY_MAGIC, format, key, (uint32_t)length };
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+#endif
+}
+
+void Shader::bindUniformBlock(const char* blockName, unsigned int binding, size_t size) const
+{
+	unsigned int index = glGetUniformBlockIndex(this->ID, blockName);
+	if (index == GL_INVALID_INDEX)
+		return; // not used by this program
+	glUniformBlockBinding(this->ID, index, binding);
+
+	int blockSize = 0;
+	glGetActiveUniformBlockiv(this->ID, index, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+	if (size != 0 && (size_t)blockSize > size)
+		std::cout << "ERROR::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH\n" << blockName <<
+			" needs " << blockSize << " bytes, got " << size << std::endl;
+}
+
+int Shader::getUniformLocation(UniformId uniform) const
+{
+	const UniformSlot* slot = findUniform(uniform);
+	return slot ? slot->location : -1;
+}
+
+void Shader::setBool(UniformId uniform, bool value) const
+{
+	setInt(uniform, (int)value);
+}
+void Shader::setInt(UniformId uniform, int value) const
+{
+	int location;
+	if (!needsUpload(uniform, &value, sizeof(value), location))
+		return;
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	if (GLHasSeparateShaderObjects())
+	{
+		glProgramUniform1i(this->ID, location, value);
+		return;
+	}
+#endif
+	glUniform1i(location, value);
+}
+void Shader::setFloat(UniformId uniform, float value) const
+{
+	int location;
+	if (!needsUpload(uniform, &value, sizeof(value), location))
+		return;
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	if (GLHasSeparateShaderObjects())
+	{
+		glProgramUniform1f(this->ID, location, value);
+		return;
+	}
+#endif
+	glUniform1f(location, value);
+}
+void Shader::setMat4(UniformId uniform, const glm::mat4& value) const
+{
+	int location;
+	if (!needsUpload(uniform, glm::value_ptr(value), sizeof(value), location))
+		return;
+#ifdef HAVE_GL_SEPARATE_SHADER_OBJECTS
+	if (GLHasSeparateShaderObjects())
+	{
+		glProgramUniformMatrix4fv(this->ID, location, 1, GL_FALSE, glm::value_ptr(value));
+		return;
+	}
+#endif
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::invalidateUniforms()
+{
+	std::fill(shadowValues.begin(), shadowValues.end(), (unsigned char)0);
+}
+
+// compares against the shadow copy and updates it. false means there is
+// nothing to send: same value as last time, or the uniform isn't active
+bool Shader::needsUpload(UniformId uniform, const void* value, size_t size, int& location) const
+{
+	const UniformSlot* slot = findUniform(uniform);
+	if (!slot)
+	{
+		uniformStats.uploadsSkipped++;
+		return false;
+	}
+	location = slot->location;
+
+	// a setter that doesn't match the declared type isn't shadowed, GL will
+	// report the error
+	if (size != slot->shadowSize)
+	{
+		uniformStats.uploadsIssued++;
+		return true;
+	}
+
+	unsigned char* shadow = &shadowValues[slot->shadowOffset];
+	if (shadow[0] && memcmp(shadow + 1, value, size) == 0)
+	{
+		uniformStats.uploadsSkipped++;
+		return false;
+	}
+	shadow[0] = 1;
+	memcpy(shadow + 1, value, size);
+	uniformStats.uploadsIssued++;
+	return true;
+}
+
+// bytes of one element of a uniform of this type
+uint32_t Shader::uniformTypeSize(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: case GL_BOOL_VEC2:
+		return 8;
+	case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: case GL_BOOL_VEC3:
+		return 12;
+	case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: case GL_BOOL_VEC4:
+	case GL_FLOAT_MAT2:
+		return 16;
+	case GL_FLOAT_MAT3:
+		return 36;
+	case GL_FLOAT_MAT4:
+		return 64;
+	case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+		return 24;
+	case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+		return 32;
+	case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+		return 48;
+	default:
+		return 4; // scalars and samplers
+	}
+}
+
+// enumerate the active uniforms once so the setters never ask the driver
+void Shader::buildUniformTable()
+{
+	int count = 0, maxLength = 0;
+	glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(this->ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<std::pair<std::string, UniformSlot>> uniforms;
+	std::vector<char> nameBuffer(maxLength + 1);
+	uint32_t shadowBytes = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int length = 0, size = 0;
+		GLenum type;
+		glGetActiveUniform(this->ID, (GLuint)i, (GLsizei)nameBuffer.size(), &length,
+			&size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), length);
+		int location = glGetUniformLocation(this->ID, name.c_str());
+		if (location == -1)
+			continue; // uniform block member, not settable through glUniform*
+
+		UniformSlot uniform{ 0, location, shadowBytes, uniformTypeSize(type) };
+		shadowBytes += 1 + uniform.shadowSize;
+		uniforms.emplace_back(name, uniform);
+		// arrays are reported as "name[0]", allow lookups by the bare name too.
+		// both names share one shadow copy since they're the same location
+		if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			uniforms.emplace_back(name.substr(0, name.size() - 3), uniform);
+	}
+
+	// keep the load factor at or below 1/2 so probe chains stay short
+	uint32_t capacity = 4;
+	while (capacity < uniforms.size() * 2)
+		capacity <<= 1;
+	this->uniformTable.assign(capacity, UniformSlot{ 0, -1, 0, 0 });
+	this->uniformMask = capacity - 1;
+	for (const auto& uniform : uniforms)
+		insertUniform(uniform.first, uniform.second);
+
+	// a new program starts with nothing shadowed
+	this->shadowValues.assign(shadowBytes, 0);
+}
+
+void Shader::insertUniform(const std::string& name, const UniformSlot& uniform)
+{
+	uint32_t hash = hashUniformName(name.c_str());
+	for (uint32_t i = hash & uniformMask;; i = (i + 1) & uniformMask)
+	{
+		UniformSlot& slot = uniformTable[i];
+		if (slot.location == -1)
+		{
+			slot = uniform;
+			slot.hash = hash;
+#ifndef NDEBUG
+			slot.name = name;
+#endif
+			return;
+		}
+		if (slot.hash == hash)
+		{
+			std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << name << std::endl;
+			return;
+		}
+	}
+}
+
+const Shader::UniformSlot* Shader::findUniform(const UniformId& uniform) const
+{
+	if (uniformTable.empty())
+		return nullptr; // not built yet
+	for (uint32_t i = uniform.hash & uniformMask;; i = (i + 1) & uniformMask)
+	{
+		const UniformSlot& slot = uniformTable[i];
+		if (slot.location == -1)
+			return nullptr;
+		if (slot.hash == uniform.hash)
+		{
+#ifndef NDEBUG
+			// an inactive uniform whose name hashes like an active one
+			if (slot.name != uniform.name)
+			{
+				std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION\n" << uniform.name <<
+					" = " << slot.name << std::endl;
+				return nullptr;
+			}
+#endif
+			return &slot;
+		}
+	}
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,130 @@
+#ifndef SHADER_QUEUE_H
+#define SHADER_QUEUE_H
+
+#include "shader.h"
+#include "gl_features.h"
+
+#include <deque>
+
+
+// builds many programs at once. submit() issues the compile/link calls without
+// asking for their status, so the driver can overlap the work (on its own
+// threads with KHR_parallel_shader_compile). handles are polled or awaited
+class ShaderBuildQueue {
+public:
+	typedef size_t Handle;
+
+	ShaderBuildQueue();
+
+	Handle submit(const char* vertexPath, const char* fragmentPath,
+		const std::string& defines = std::string());
+	Handle submit(SourceView vertexSource, SourceView fragmentSource,
+		const std::string& defines = std::string());
+
+	// never blocks. always true without KHR_parallel_shader_compile
+	bool isReady(Handle handle) const;
+	// checks the result (blocking if the driver isn't done) and returns the shader
+	Shader& wait(Handle handle);
+	void waitAll();
+
+	size_t pendingCount() const { return pending; }
+
+private:
+	struct Job {
+		Shader shader;
+		Shader::PendingBuild build;
+		bool finished = false;
+	};
+	std::deque<Job> jobs; // deque so returned Shader references stay valid
+	size_t pending = 0;
+
+	Handle submit(ShaderSource& vertexSource, ShaderSource& fragmentSource,
+		const std::string& defines);
+};
+
+ShaderBuildQueue::ShaderBuildQueue()
+{
+#ifdef HAVE_GL_PARALLEL_SHADER_COMPILE
+	// let the driver pick how many compiler threads to use
+	if (GLHasParallelShaderCompile())
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+#endif
+}
+
+ShaderBuildQueue::Handle ShaderBuildQueue::submit(const char* vertexPath, const char* fragmentPath,
+	const std::string& defines)
+{
+	ShaderSource vertex = Shader::sourceLoader().load(vertexPath);
+	ShaderSource fragment = Shader::sourceLoader().load(fragmentPath);
+	return submit(vertex, fragment, defines);
+}
+
+ShaderBuildQueue::Handle ShaderBuildQueue::submit(SourceView vertexSource, SourceView fragmentSource,
+	const std::string& defines)
+{
+	ShaderSource vertex, fragment;
+	vertex.append(vertexSource);
+	fragment.append(fragmentSource);
+	return submit(vertex, fragment, defines);
+}
+
+ShaderBuildQueue::Handle ShaderBuildQueue::submit(ShaderSource& vertexSource,
+	ShaderSource& fragmentSource, const std::string& defines)
+{
+	vertexSource.insertAfterVersion(defines.data(), defines.size());
+	fragmentSource.insertAfterVersion(defines.data(), defines.size());
+	jobs.emplace_back();
+	Job& job = jobs.back();
+	job.build = job.shader.beginBuild(vertexSource, fragmentSource);
+	pending++;
+	return jobs.size() - 1;
+}
+
+bool ShaderBuildQueue::isReady(Handle handle) const
+{
+	const Job& job = jobs[handle];
+	return job.finished || job.shader.isBuildComplete(job.build);
+}
+
+Shader& ShaderBuildQueue::wait(Handle handle)
+{
+	Job& job = jobs[handle];
+	if (!job.finished)
+	{
+		job.shader.finishBuild(job.build);
+		job.finished = true;
+		pending--;
+	}
+	return job.shader;
+}
+
+// finish whatever is already done first, so the blocking queries come last
+void ShaderBuildQueue::waitAll()
+{
+	while (pending > 0)
+	{
+		bool progressed = false;
+		for (Handle i = 0; i < jobs.size(); i++)
+		{
+			if (!jobs[i].finished && isReady(i))
+			{
+				wait(i);
+				progressed = true;
+			}
+		}
+		if (!progressed)
+		{
+			// nothing reported complete yet, block on the oldest
+			for (Handle i = 0; i < jobs.size(); i++)
+			{
+				if (!jobs[i].finished)
+				{
+					wait(i);
+					break;
+				}
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,377 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "shader.h"
+#include "shader_source.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+
+// recompiles watched shaders when one of their files changes on disk. the
+// compile runs on a background thread with its own (shared) GL context and
+// the new program is only swapped in by update() once it linked and the GPU
+// finished with it, so the render loop never waits on a compile.
+// changes are picked up with inotify on linux and by polling mtimes elsewhere
+class ShaderHotReload {
+public:
+	// re-run on the new program, sampler units and block bindings don't carry over
+	typedef std::function<void(Shader&)> SetupCallback;
+
+	// creates the hidden worker context, call on the GL thread
+	explicit ShaderHotReload(GLFWwindow* window);
+	~ShaderHotReload();
+
+	// only shaders built from files can be watched. watching again just
+	// replaces the setup callback
+	void watch(Shader& shader, SetupCallback setup = nullptr);
+
+	// call once a frame on the GL thread: swaps in programs that are ready
+	void update();
+
+	// joins the worker and destroys its context, call before glfwTerminate
+	void stop();
+
+private:
+	struct Watched {
+		Shader* shader;
+		SetupCallback setup;
+		std::vector<std::string> files; // everything the program was built from
+		uint64_t sourceHash;             // of the text of the running program
+	};
+	struct Result {
+		Watched* entry;
+		std::unique_ptr<Shader> shader;
+		GLsync fence;
+		std::vector<std::string> files;
+	};
+
+	GLFWwindow* context;
+	std::thread worker;
+	std::atomic<bool> stopping{ false };
+
+	std::mutex mutex; // guards watched (the list and each files vector) and results
+	std::vector<std::unique_ptr<Watched>> watched;
+	std::vector<Result> results;
+
+	void run();
+	std::vector<std::string> waitForChanges();
+	void rebuild(Watched& entry);
+
+#ifdef __linux__
+	int inotifyFd = -1;
+	std::unordered_map<std::string, int> directoryWatches; // directory -> wd
+	std::unordered_map<int, std::string> watchDirectories; // wd -> directory
+#else
+	std::unordered_map<std::string, long long> modifiedTimes;
+	static long long modifiedTime(const std::string& path);
+#endif
+	std::vector<std::string> watchedFiles();
+	static std::string directoryOf(const std::string& path);
+};
+
+ShaderHotReload::ShaderHotReload(GLFWwindow* window)
+{
+	// invisible 1x1 window whose context shares objects with the main one
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	this->context = glfwCreateWindow(1, 1, "shader reload", NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (this->context == NULL)
+	{
+		std::cout << "ERROR::SHADER::RELOAD::CONTEXT_CREATION_FAILED" << std::endl;
+		return;
+	}
+#ifdef __linux__
+	this->inotifyFd = inotify_init1(IN_NONBLOCK);
+#endif
+	this->worker = std::thread(&ShaderHotReload::run, this);
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+	stop();
+}
+
+void ShaderHotReload::watch(Shader& shader, SetupCallback setup)
+{
+	if (shader.vertexPath.empty())
+		return; // built from memory, nothing on disk to watch
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& entry : watched)
+	{
+		if (entry->shader == &shader)
+		{
+			entry->setup = std::move(setup);
+			return;
+		}
+	}
+
+	// remember what the running program was built from, so touching a file
+	// without changing it never triggers a rebuild
+	ShaderSource vertex = Shader::sourceLoader().load(shader.vertexPath);
+	ShaderSource fragment = Shader::sourceLoader().load(shader.fragmentPath);
+	vertex.insertAfterVersion(shader.defines.data(), shader.defines.size());
+	fragment.insertAfterVersion(shader.defines.data(), shader.defines.size());
+
+	std::unique_ptr<Watched> entry(new Watched());
+	entry->shader = &shader;
+	entry->setup = std::move(setup);
+	entry->files = vertex.files;
+	entry->files.insert(entry->files.end(), fragment.files.begin(), fragment.files.end());
+	entry->sourceHash = Shader::hashSources(vertex, fragment);
+	watched.push_back(std::move(entry));
+}
+
+void ShaderHotReload::update()
+{
+	std::vector<Result> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < results.size();)
+		{
+			// never wait here, a program the GPU hasn't caught up with waits a frame
+			GLenum status = glClientWaitSync(results[i].fence, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+			{
+				ready.push_back(std::move(results[i]));
+				results.erase(results.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	// outside the lock, the setup callback may watch() more shaders
+	for (Result& result : ready)
+	{
+		glDeleteSync(result.fence);
+		// variants built later on this thread must see the new text too
+		for (const std::string& file : result.files)
+			Shader::sourceLoader().invalidate(file);
+
+		Shader& shader = *result.entry->shader;
+		shader.swapProgram(*result.shader);
+		glDeleteProgram(result.shader->ID); // the old program now
+		if (result.entry->setup)
+		{
+			shader.use();
+			result.entry->setup(shader);
+		}
+		std::cout << "shader reloaded: " << shader.fragmentPath << std::endl;
+	}
+}
+
+void ShaderHotReload::stop()
+{
+	if (this->context == NULL)
+		return;
+	stopping = true;
+	if (worker.joinable())
+		worker.join();
+	for (Result& result : results)
+	{
+		glDeleteSync(result.fence);
+		glDeleteProgram(result.shader->ID);
+	}
+	results.clear();
+#ifdef __linux__
+	if (inotifyFd >= 0)
+		close(inotifyFd);
+	inotifyFd = -1;
+#endif
+	glfwDestroyWindow(this->context);
+	this->context = NULL;
+}
+
+void ShaderHotReload::run()
+{
+	glfwMakeContextCurrent(this->context);
+	while (!stopping)
+	{
+		std::vector<std::string> changed = waitForChanges();
+		if (changed.empty())
+			continue;
+
+		std::vector<Watched*> dirty;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& entry : watched)
+			{
+				for (const std::string& file : entry->files)
+				{
+					if (std::find(changed.begin(), changed.end(), file) != changed.end())
+					{
+						dirty.push_back(entry.get());
+						break;
+					}
+				}
+			}
+		}
+		for (Watched* entry : dirty)
+			rebuild(*entry);
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+// runs on the worker, with its own loader since the shared one isn't thread safe
+void ShaderHotReload::rebuild(Watched& entry)
+{
+	const Shader& shader = *entry.shader;
+	ShaderSourceLoader loader;
+	ShaderSource vertex = loader.load(shader.vertexPath);
+	ShaderSource fragment = loader.load(shader.fragmentPath);
+	vertex.insertAfterVersion(shader.defines.data(), shader.defines.size());
+	fragment.insertAfterVersion(shader.defines.data(), shader.defines.size());
+	{
+		// includes may have been added or removed
+		std::lock_guard<std::mutex> lock(mutex);
+		entry.files = vertex.files;
+		entry.files.insert(entry.files.end(), fragment.files.begin(), fragment.files.end());
+	}
+
+	uint64_t hash = Shader::hashSources(vertex, fragment);
+	if (hash == entry.sourceHash)
+		return; // saved without changes
+
+	std::unique_ptr<Shader> fresh(new Shader(vertex, fragment));
+	int success;
+	glGetProgramiv(fresh->ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		// the errors are already printed, keep running the old program
+		glDeleteProgram(fresh->ID);
+		return;
+	}
+	entry.sourceHash = hash;
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); // so the fence can signal without this context doing more work
+	std::lock_guard<std::mutex> lock(mutex);
+	results.push_back(Result{ &entry, std::move(fresh), fence, entry.files });
+}
+
+std::vector<std::string> ShaderHotReload::watchedFiles()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<std::string> files;
+	for (auto& entry : watched)
+		files.insert(files.end(), entry->files.begin(), entry->files.end());
+	return files;
+}
+
+std::string ShaderHotReload::directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+#ifdef __linux__
+
+// blocks for up to 250ms waiting for writes in any watched directory
+std::vector<std::string> ShaderHotReload::waitForChanges()
+{
+	std::vector<std::string> changed;
+	if (inotifyFd < 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		return changed;
+	}
+
+	for (const std::string& file : watchedFiles())
+	{
+		std::string directory = directoryOf(file);
+		if (directoryWatches.count(directory))
+			continue;
+		// editors often save by renaming a temp file over the original
+		int wd = inotify_add_watch(inotifyFd, directory.empty() ? "." : directory.c_str(),
+			IN_CLOSE_WRITE | IN_MOVED_TO);
+		directoryWatches[directory] = wd;
+		if (wd >= 0)
+			watchDirectories[wd] = directory;
+	}
+
+	pollfd fd{ inotifyFd, POLLIN, 0 };
+	if (poll(&fd, 1, 250) <= 0)
+		return changed;
+	// a save is often several events, let them all arrive
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length;
+	while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+	{
+		for (char* p = buffer; p < buffer + length;)
+		{
+			const inotify_event* event = (const inotify_event*)p;
+			auto directory = watchDirectories.find(event->wd);
+			if (event->len > 0 && directory != watchDirectories.end())
+				changed.push_back(directory->second + event->name);
+			p += sizeof(inotify_event) + event->len;
+		}
+	}
+	return changed;
+}
+
+#else
+
+long long ShaderHotReload::modifiedTime(const std::string& path)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return 0;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return 0;
+#endif
+	return (long long)info.st_mtime;
+}
+
+// no inotify: compare modification times every 250ms
+std::vector<std::string> ShaderHotReload::waitForChanges()
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(250));
+	std::vector<std::string> changed;
+	for (const std::string& file : watchedFiles())
+	{
+		long long time = modifiedTime(file);
+		auto known = modifiedTimes.find(file);
+		if (known == modifiedTimes.end())
+			modifiedTimes[file] = time; // first sighting, nothing to compare to
+		else if (known->second != time)
+		{
+			known->second = time;
+			changed.push_back(file);
+		}
+	}
+	return changed;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+
+
+// shader text that is already in memory, e.g. sources embedded in the
+// executable by embed_shaders.ps1. no #include expansion is done on these
+struct SourceView {
+	const char* data;
+	size_t length;
+
+	constexpr SourceView() : data(nullptr), length(0) {}
+	template <size_t N>
+	constexpr SourceView(const char (&text)[N]) : data(text), length(N - 1) {}
+};
+
+
+// one shader after #include expansion: pieces of the cached files in order,
+// laid out exactly as glShaderSource(shader, count, strings, lengths) wants
+struct ShaderSource {
+	std::vector<const GLchar*> strings;
+	std::vector<GLint> lengths;
+	std::vector<std::string> files; // every file read to build it, top-level first
+
+	GLsizei count() const { return (GLsizei)strings.size(); }
+	void append(const char* data, size_t length)
+	{
+		if (length == 0)
+			return;
+		strings.push_back(data);
+		lengths.push_back((GLint)length);
+	}
+	void append(SourceView view) { append(view.data, view.length); }
+
+	// splice text in right after the #version line (or at the very start
+	// without one), e.g. the #defines of a shader variant
+	void insertAfterVersion(const char* data, size_t length);
+};
+
+void ShaderSource::insertAfterVersion(const char* data, size_t length)
+{
+	if (length == 0)
+		return;
+	if (strings.empty())
+	{
+		append(data, length);
+		return;
+	}
+
+	// #version has to stay first, so split the top-level file after that line
+	static const char tag[] = "#version";
+	const char* begin = strings[0];
+	const char* end = begin + lengths[0];
+	const char* split = std::search(begin, end, tag, tag + sizeof(tag) - 1);
+	if (split == end)
+		split = begin;
+	else if ((split = std::find(split, end, '\n')) != end)
+		split++;
+
+	strings.insert(strings.begin() + 1, { data, split });
+	lengths.insert(lengths.begin() + 1, { (GLint)length, (GLint)(end - split) });
+	lengths[0] = (GLint)(split - begin);
+}
+
+
+// reads each file with a single read and keeps it, so includes shared by many
+// shaders are loaded once. returned views point into the cache: they are
+// valid until the file is invalidated. not thread safe
+class ShaderSourceLoader {
+public:
+	// loads path and expands #include "file" (relative to the including file).
+	// every file is included at most once, which also breaks include cycles
+	ShaderSource load(const std::string& path);
+
+	// forget a cached file, e.g. after it changed on disk
+	void invalidate(const std::string& path);
+
+private:
+	struct Include {
+		size_t begin, end; // the directive line, newline included
+		std::string path;
+	};
+	struct File {
+		std::string contents;
+		std::vector<Include> includes;
+	};
+	std::unordered_map<std::string, std::unique_ptr<File>> cache;
+
+	const File* getFile(const std::string& path);
+	void expand(const std::string& path, ShaderSource& source, std::vector<std::string>& included);
+	static bool readFile(const std::string& path, std::string& contents);
+	static void parseIncludes(const std::string& path, File& file);
+};
+
+ShaderSource ShaderSourceLoader::load(const std::string& path)
+{
+	ShaderSource source;
+	expand(path, source, source.files);
+	return source;
+}
+
+void ShaderSourceLoader::invalidate(const std::string& path)
+{
+	cache.erase(path);
+}
+
+const ShaderSourceLoader::File* ShaderSourceLoader::getFile(const std::string& path)
+{
+	auto it = cache.find(path);
+	if (it != cache.end())
+		return it->second.get();
+
+	std::unique_ptr<File> file(new File());
+	if (!readFile(path, file->contents))
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ\n" << path << std::endl;
+		return nullptr;
+	}
+	parseIncludes(path, *file);
+	return (cache[path] = std::move(file)).get();
+}
+
+void ShaderSourceLoader::expand(const std::string& path, ShaderSource& source,
+	std::vector<std::string>& included)
+{
+	for (const std::string& done : included)
+		if (done == path)
+			return;
+	included.push_back(path);
+
+	const File* file = getFile(path);
+	if (!file)
+		return;
+
+	// text between includes goes in as views, the directives themselves are skipped
+	size_t position = 0;
+	for (const Include& include : file->includes)
+	{
+		source.append(file->contents.data() + position, include.begin - position);
+		expand(include.path, source, included);
+		position = include.end;
+	}
+	source.append(file->contents.data() + position, file->contents.size() - position);
+}
+
+// size the buffer up front and read the whole file in one go
+bool ShaderSourceLoader::readFile(const std::string& path, std::string& contents)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	contents.resize((size_t)size);
+	return size == 0 || (bool)file.read(&contents[0], size);
+}
+
+// find every line of the form: #include "name"
+void ShaderSourceLoader::parseIncludes(const std::string& path, File& file)
+{
+	const std::string& text = file.contents;
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	size_t lineBegin = 0;
+	while (lineBegin < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineBegin);
+		lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+
+		size_t i = text.find_first_not_of(" \t", lineBegin);
+		if (i < lineEnd && text.compare(i, 8, "#include") == 0)
+		{
+			size_t open = text.find('"', i + 8);
+			size_t close = open < lineEnd ? text.find('"', open + 1) : std::string::npos;
+			if (close < lineEnd)
+				file.includes.push_back(Include{ lineBegin, lineEnd,
+					directory + text.substr(open + 1, close - open - 1) });
+			else
+				std::cout << "ERROR::SHADER::MALFORMED_INCLUDE\n" << path << std::endl;
+		}
+		lineBegin = lineEnd;
+	}
+}
+
+#endif
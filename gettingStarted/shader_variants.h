@@ -0,0 +1,105 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include "shader.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cassert>
+#include <iostream>
+#include <functional>
+#include <unordered_map>
+
+
+// specialized programs generated from one vertex/fragment pair. bit i of a
+// variant mask turns on "#define keys[i]"; each combination is compiled the
+// first time it is asked for and cached, so only the used ones are ever built
+class ShaderVariants {
+public:
+	// the mask is 32 bits, and shifting it by 32 isn't defined
+	static constexpr size_t MAX_KEYS = 31;
+
+	// called once on every freshly built variant, e.g. to set sampler units.
+	// the variant is bound while it runs, for setters without glProgramUniform*
+	typedef std::function<void(Shader&)> SetupCallback;
+
+	ShaderVariants(const char* vertexPath, const char* fragmentPath,
+		std::vector<std::string> keys, SetupCallback setup = nullptr);
+	// embedded sources, the views must outlive this object
+	ShaderVariants(SourceView vertexSource, SourceView fragmentSource,
+		std::vector<std::string> keys, SetupCallback setup = nullptr);
+
+	Shader& get(uint32_t mask);
+
+	size_t compiledCount() const { return variants.size(); }
+
+private:
+	std::string vertexPath, fragmentPath;
+	SourceView vertexSource, fragmentSource; // used when the paths are empty
+	std::vector<std::string> keys;
+	SetupCallback setup;
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
+
+	std::string definesFor(uint32_t mask) const;
+	void checkKeys();
+};
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath,
+	std::vector<std::string> keys, SetupCallback setup)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), keys(std::move(keys)),
+	setup(std::move(setup))
+{
+	checkKeys();
+}
+
+ShaderVariants::ShaderVariants(SourceView vertexSource, SourceView fragmentSource,
+	std::vector<std::string> keys, SetupCallback setup)
+	: vertexSource(vertexSource), fragmentSource(fragmentSource), keys(std::move(keys)),
+	setup(std::move(setup))
+{
+	checkKeys();
+}
+
+void ShaderVariants::checkKeys()
+{
+	assert(keys.size() <= MAX_KEYS && "more shader variant keys than mask bits");
+	if (keys.size() > MAX_KEYS)
+	{
+		std::cout << "ERROR::SHADER::VARIANT::TOO_MANY_KEYS\n" << keys.size() << std::endl;
+		keys.resize(MAX_KEYS); // the rest can't be selected
+	}
+}
+
+Shader& ShaderVariants::get(uint32_t mask)
+{
+	auto it = variants.find(mask);
+	if (it != variants.end())
+		return *it->second;
+
+	std::string defines = definesFor(mask);
+	std::unique_ptr<Shader> shader(vertexPath.empty() ?
+		new Shader(vertexSource, fragmentSource, defines) :
+		new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+	if (setup)
+	{
+		shader->use();
+		setup(*shader);
+	}
+	return *(variants[mask] = std::move(shader));
+}
+
+std::string ShaderVariants::definesFor(uint32_t mask) const
+{
+	std::string defines;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		if (mask & (1u << i))
+			defines += "#define " + keys[i] + "\n";
+	}
+	if (mask >> keys.size())
+		std::cout << "ERROR::SHADER::VARIANT::UNKNOWN_KEY_BITS\n" << mask << std::endl;
+	return defines;
+}
+
+#endif
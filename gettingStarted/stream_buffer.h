@@ -0,0 +1,159 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl_features.h"
+#include "gl_state.h"
+
+#include <cstddef>
+#include <iostream>
+
+
+// a buffer for data rewritten every frame. with GL 4.4/ARB_buffer_storage it
+// is mapped once, persistently and coherently, and split into REGIONS parts
+// used in turn: the CPU fills one while the GPU may still read the others,
+// and a fence per region makes sure it never overwrites one in use. so a
+// frame costs no map/unmap and no implicit sync. without it, every begin()
+// orphans the buffer and maps it again, which the driver keeps sync-free too
+class StreamBuffer {
+public:
+	static constexpr unsigned int REGIONS = 3;
+
+	unsigned int ID;
+	GLenum target;
+	size_t regionSize; // bytes writable per begin()
+
+	StreamBuffer(GLenum target, size_t regionSize);
+
+	// fences the region written last (its draws are issued by now) and returns
+	// the next one, waiting only if the GPU is still REGIONS frames behind.
+	// NULL if the buffer couldn't be mapped
+	void* begin();
+	// returns the offset of the region just written, for attribute pointers
+	// or glBindBufferRange
+	size_t end();
+
+	// drops the contents and reallocates, e.g. when the data outgrew it
+	void resize(size_t regionSize);
+
+	bool isPersistent() const { return mapped != NULL; }
+	unsigned int stallCount() const { return stalls; } // times begin() had to wait
+
+	void release();
+
+private:
+	char* mapped;            // the whole buffer when persistent
+	GLsync fences[REGIONS];
+	unsigned int region;     // the one begin() handed out last
+	bool written;            // region holds data a fence hasn't covered yet
+	unsigned int stalls;
+
+	void allocate();
+};
+
+StreamBuffer::StreamBuffer(GLenum target, size_t regionSize)
+	: ID(0), target(target), regionSize(0), mapped(NULL), fences(), region(0),
+	written(false), stalls(0)
+{
+	resize(regionSize);
+}
+
+void* StreamBuffer::begin()
+{
+	GLStateCache::get().bindBuffer(this->target, this->ID);
+	if (!isPersistent())
+	{
+		// orphan: new storage for this frame, the old one lives on while in use
+		glBufferData(this->target, this->regionSize, NULL, GL_STREAM_DRAW);
+		return glMapBufferRange(this->target, 0, this->regionSize,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+
+	if (written)
+	{
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		written = false;
+	}
+	region = (region + 1) % REGIONS;
+	if (fences[region])
+	{
+		GLenum status = glClientWaitSync(fences[region], 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			stalls++;
+			// flush so the fence can signal at all, then block for up to 1s at a time
+			do
+				status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			while (status == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fences[region]);
+		fences[region] = 0;
+	}
+	written = true;
+	return this->mapped + region * this->regionSize;
+}
+
+size_t StreamBuffer::end()
+{
+	if (!isPersistent())
+	{
+		GLStateCache::get().bindBuffer(this->target, this->ID);
+		glUnmapBuffer(this->target);
+		return 0;
+	}
+	return region * this->regionSize; // coherent, nothing to flush
+}
+
+void StreamBuffer::resize(size_t regionSize)
+{
+	release();
+	// keep every region offset aligned for attributes and uniform ranges
+	this->regionSize = ((regionSize ? regionSize : 1) + 255) & ~(size_t)255;
+	allocate();
+}
+
+void StreamBuffer::allocate()
+{
+	glGenBuffers(1, &this->ID);
+	GLStateCache::get().bindBuffer(this->target, this->ID);
+#ifdef HAVE_GL_BUFFER_STORAGE
+	if (GLHasBufferStorage())
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(this->target, REGIONS * this->regionSize, NULL, flags);
+		this->mapped = (char*)glMapBufferRange(this->target, 0, REGIONS * this->regionSize, flags);
+		if (this->mapped == NULL)
+			std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+		else
+			return;
+		// immutable storage can't be orphaned, start over with a mutable buffer
+		GLStateCache::get().forgetBuffer(this->ID);
+		glDeleteBuffers(1, &this->ID);
+		glGenBuffers(1, &this->ID);
+		GLStateCache::get().bindBuffer(this->target, this->ID);
+	}
+#endif
+	glBufferData(this->target, this->regionSize, NULL, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::release()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+	if (this->ID)
+	{
+		GLStateCache::get().forgetBuffer(this->ID);
+		glDeleteBuffers(1, &this->ID); // also unmaps
+	}
+	this->ID = 0;
+	this->mapped = NULL;
+	this->region = 0;
+	this->written = false;
+}
+
+#endif
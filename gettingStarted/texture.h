@@ -0,0 +1,203 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include "gl_features.h"
+#include "gl_state.h"
+#include "block_compress.h"
+#include "stb_image.h"
+
+#include <cstddef>
+#include <iostream>
+
+
+// a 2D texture and what it costs on the GPU
+struct TextureInfo {
+	unsigned int ID;
+	int width, height;
+	int levels;            // mip levels allocated
+	GLenum internalFormat;
+	size_t gpuBytes;       // every level at the format's size, drivers may pad RGB8 to 4 bytes
+};
+
+// sized format matching stb_image's channel count: grey, grey+alpha, RGB, RGBA
+GLenum textureInternalFormat(int nrChannels)
+{
+	switch (nrChannels)
+	{
+	case 1: return GL_R8;
+	case 2: return GL_RG8;
+	case 3: return GL_RGB8;
+	default: return GL_RGBA8;
+	}
+}
+
+GLenum texturePixelFormat(int nrChannels)
+{
+	switch (nrChannels)
+	{
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 3: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+// GL_NONE without the S3TC extension
+GLenum blockInternalFormat(BlockFormat format)
+{
+#ifdef HAVE_GL_TEXTURE_COMPRESSION_S3TC
+	return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+#else
+	return GL_NONE;
+#endif
+}
+
+// full chain down to 1x1
+int textureLevelCount(int width, int height)
+{
+	int levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		levels++;
+	}
+	return levels;
+}
+
+size_t textureBytes(int width, int height, int bytesPerTexel, int levels)
+{
+	size_t bytes = 0;
+	for (int level = 0; level < levels; level++)
+	{
+		bytes += (size_t)width * height * bytesPerTexel;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return bytes;
+}
+
+// a new texture, bound on unit 0
+unsigned int genTexture2D(GLint minFilter, GLint magFilter)
+{
+	unsigned int ID;
+	glGenTextures(1, &ID);
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, ID);
+	// set texture wrapping for s & t (as repeat)
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+	return ID;
+}
+
+// a new texture with storage for a full mip chain but no pixels yet. the
+// storage is immutable (glTexStorage2D) with GL 4.2/ARB_texture_storage, so
+// the driver neither reallocates nor converts. leaves it bound on unit 0.
+// no pixel unpack buffer may be bound, the GL 3.3 path would read from it
+TextureInfo allocateTexture2D(int width, int height, int nrChannels,
+	GLint minFilter = GL_NEAREST, GLint magFilter = GL_NEAREST)
+{
+	TextureInfo texture;
+	texture.width = width;
+	texture.height = height;
+	texture.levels = textureLevelCount(width, height);
+	texture.internalFormat = textureInternalFormat(nrChannels);
+	GLenum format = texturePixelFormat(nrChannels);
+
+	texture.ID = genTexture2D(minFilter, magFilter);
+	// grey images sample as grey, not red
+	if (nrChannels == 1 || nrChannels == 2)
+	{
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, nrChannels == 2 ? GL_GREEN : GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+
+	bool immutable = false;
+#ifdef HAVE_GL_TEXTURE_STORAGE
+	if (GLHasTextureStorage())
+	{
+		glTexStorage2D(GL_TEXTURE_2D, texture.levels, texture.internalFormat, width, height);
+		immutable = true;
+	}
+#endif
+	if (!immutable)
+	{
+		// same allocation, one level at a time
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+		for (int level = 0, w = width, h = height; level < texture.levels; level++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, w, h, 0, format,
+				GL_UNSIGNED_BYTE, NULL);
+			w = w > 1 ? w / 2 : 1;
+			h = h > 1 ? h / 2 : 1;
+		}
+	}
+	texture.gpuBytes = textureBytes(width, height, nrChannels, texture.levels);
+	return texture;
+}
+
+// stb rows aren't padded, 4 byte alignment only fits some widths
+void setUnpackAlignment(int width, int nrChannels)
+{
+	glPixelStorei(GL_UNPACK_ALIGNMENT, (width * nrChannels) % 4 == 0 ? 4 : 1);
+}
+
+// uploads pixels as decoded by stb_image (nrChannels bytes per texel, rows
+// tightly packed) into a new texture and fills its mip chain
+TextureInfo createTexture2D(const unsigned char* pixels, int width, int height, int nrChannels,
+	GLint minFilter = GL_NEAREST, GLint magFilter = GL_NEAREST)
+{
+	TextureInfo texture = allocateTexture2D(width, height, nrChannels, minFilter, magFilter);
+	setUnpackAlignment(width, nrChannels);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, texturePixelFormat(nrChannels),
+		GL_UNSIGNED_BYTE, pixels);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	return texture;
+}
+
+// a texture from a block compressed mip chain as made by compressMipChain.
+// blocks may be an offset into a bound pixel unpack buffer. the S3TC
+// extension must be there. leaves it bound on unit 0
+TextureInfo createCompressedTexture2D(BlockFormat format, const unsigned char* blocks, int width, int height,
+	GLint minFilter = GL_NEAREST, GLint magFilter = GL_NEAREST)
+{
+	TextureInfo texture;
+	texture.ID = genTexture2D(minFilter, magFilter);
+	texture.width = width;
+	texture.height = height;
+	texture.levels = textureLevelCount(width, height);
+	texture.internalFormat = blockInternalFormat(format);
+	texture.gpuBytes = blockChainBytes(width, height, format);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+	for (int level = 0, w = width, h = height; level < texture.levels; level++)
+	{
+		GLsizei size = (GLsizei)blockLevelBytes(w, h, format);
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, w, h, 0, size, blocks);
+		blocks += size;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	return texture;
+}
+
+// decodes an image file with stb_image and creates its texture. ID is 0 if
+// the file couldn't be loaded
+TextureInfo loadTexture2D(const char* path, GLint minFilter = GL_NEAREST, GLint magFilter = GL_NEAREST)
+{
+	int width, height, nrChannels;
+	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
+	if (!data)
+	{
+		std::cout << "ERROR::TEXTURE::LOAD_FAILED\n" << path << std::endl;
+		return TextureInfo{ 0, 0, 0, 0, GL_NONE, 0 };
+	}
+	TextureInfo texture = createTexture2D(data, width, height, nrChannels, minFilter, magFilter);
+	stbi_image_free(data);
+	return texture;
+}
+
+#endif
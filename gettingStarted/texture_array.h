@@ -0,0 +1,140 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include "gl_features.h"
+#include "gl_state.h"
+#include "texture.h"
+#include "stb_image.h"
+
+#include <vector>
+#include <iostream>
+
+
+// images as the layers of one GL_TEXTURE_2D_ARRAY, so draws using different
+// images share a single binding and can go out in one batch. the shader picks
+// a layer with the 3rd texture coordinate (a uniform or instance attribute).
+// every layer is RGBA8 of the same size, other sizes are resized on load
+class TextureArray {
+public:
+	unsigned int ID;
+	int width, height;
+	int layers;
+
+	// allocates the layers, leaves the array bound on unit 0
+	TextureArray(int width, int height, int layers);
+
+	// decodes the image at path into a layer, false if it couldn't be loaded
+	bool loadLayer(int layer, const char* path);
+
+	// call once all layers are loaded
+	void generateMipmaps() const;
+
+private:
+	// bilinear, fine for the moderate factors between texture sizes
+	static void resize(const unsigned char* source, int sourceWidth, int sourceHeight,
+		unsigned char* target, int targetWidth, int targetHeight);
+};
+
+TextureArray::TextureArray(int width, int height, int layers)
+	: width(width), height(height), layers(layers)
+{
+	glGenTextures(1, &this->ID);
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, this->ID);
+	// set texture wrapping for s & t (as repeat)
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// same filtering as the single textures
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+#ifdef HAVE_GL_TEXTURE_STORAGE
+	if (GLHasTextureStorage())
+	{
+		// immutable, every layer with its full mip chain
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, textureLevelCount(width, height), GL_RGBA8,
+			width, height, layers);
+		return;
+	}
+#endif
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, NULL);
+}
+
+bool TextureArray::loadLayer(int layer, const char* path)
+{
+	if (layer < 0 || layer >= this->layers)
+	{
+		std::cout << "ERROR::TEXTURE_ARRAY::LAYER_OUT_OF_RANGE\n" << path << std::endl;
+		return false;
+	}
+
+	int imageWidth, imageHeight, nrChannels;
+	// always 4 channels, so jpgs and pngs fit the same RGBA8 layers
+	unsigned char* data = stbi_load(path, &imageWidth, &imageHeight, &nrChannels, 4);
+	if (!data)
+	{
+		std::cout << "ERROR::TEXTURE_ARRAY::LOAD_FAILED\n" << path << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned char> resized;
+	const unsigned char* pixels = data;
+	if (imageWidth != this->width || imageHeight != this->height)
+	{
+		resized.resize((size_t)this->width * this->height * 4);
+		resize(data, imageWidth, imageHeight, resized.data(), this->width, this->height);
+		pixels = resized.data();
+	}
+
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, this->ID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // RGBA rows are always 4 byte aligned
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, this->width, this->height, 1,
+		GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	stbi_image_free(data);
+	return true;
+}
+
+void TextureArray::generateMipmaps() const
+{
+	GLStateCache::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, this->ID);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+void TextureArray::resize(const unsigned char* source, int sourceWidth, int sourceHeight,
+	unsigned char* target, int targetWidth, int targetHeight)
+{
+	float scaleX = (float)sourceWidth / targetWidth;
+	float scaleY = (float)sourceHeight / targetHeight;
+	for (int y = 0; y < targetHeight; y++)
+	{
+		// sample at pixel centres, clamped to the edge
+		float sy = (y + 0.5f) * scaleY - 0.5f;
+		sy = sy < 0.0f ? 0.0f : sy;
+		int y0 = (int)sy;
+		int y1 = y0 + 1 < sourceHeight ? y0 + 1 : sourceHeight - 1;
+		float fy = sy - y0;
+		for (int x = 0; x < targetWidth; x++)
+		{
+			float sx = (x + 0.5f) * scaleX - 0.5f;
+			sx = sx < 0.0f ? 0.0f : sx;
+			int x0 = (int)sx;
+			int x1 = x0 + 1 < sourceWidth ? x0 + 1 : sourceWidth - 1;
+			float fx = sx - x0;
+
+			const unsigned char* p00 = source + ((size_t)y0 * sourceWidth + x0) * 4;
+			const unsigned char* p10 = source + ((size_t)y0 * sourceWidth + x1) * 4;
+			const unsigned char* p01 = source + ((size_t)y1 * sourceWidth + x0) * 4;
+			const unsigned char* p11 = source + ((size_t)y1 * sourceWidth + x1) * 4;
+			unsigned char* out = target + ((size_t)y * targetWidth + x) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				float top = p00[c] + (p10[c] - p00[c]) * fx;
+				float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+				out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+			}
+		}
+	}
+}
+
+#endif
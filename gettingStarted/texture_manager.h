@@ -0,0 +1,157 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include "texture_streamer.h"
+#include "texture_residency.h"
+
+#include <string>
+#include <unordered_map>
+
+
+class TextureManager;
+
+// counted reference to a texture of a TextureManager. copies share it, the
+// GL texture is deleted when the last one is destroyed or reset
+class Texture2D {
+public:
+	Texture2D() : manager(nullptr), handle(0) {}
+	Texture2D(const Texture2D& other);
+	Texture2D(Texture2D&& other);
+	Texture2D& operator=(Texture2D other);
+	~Texture2D();
+
+	// the placeholder until loaded, 0 for an empty reference. the texture
+	// to bind, an evicted one is streamed in again
+	unsigned int id() const;
+	bool isReady() const;
+	explicit operator bool() const { return manager != nullptr; }
+
+	// drops this reference now, instead of at the end of the scope
+	void reset();
+
+private:
+	friend class TextureManager;
+	TextureManager* manager;
+	TextureStreamer::Handle handle;
+
+	Texture2D(TextureManager* manager, TextureStreamer::Handle handle)
+		: manager(manager), handle(handle) {}
+};
+
+
+// loads textures by path through a TextureStreamer. a path already loaded,
+// or a file with the same bytes as one, is decoded and uploaded only once.
+// with a budget, the least recently bound textures are evicted to stay within it
+class TextureManager {
+public:
+	// budgetBytes of texture memory, 0 for no limit
+	explicit TextureManager(unsigned int workerCount = 2, UploadScheduler* scheduler = nullptr,
+		size_t budgetBytes = 0);
+
+	// block compress what's loaded after this, see TextureStreamer::enableCompression
+	void enableCompression(const std::string& cacheDirectory = "") { streamer.enableCompression(cacheDirectory); }
+
+	Texture2D load(const std::string& path, int priority = 0);
+
+	// call once a frame on the GL thread, before drawing
+	void update();
+
+	size_t textureCount() const { return paths.size(); }
+	size_t gpuBytes() const { return streamer.gpuBytes(); }
+	TextureResidency& residency() { return resident; }
+
+	// deletes every texture, references released later do nothing.
+	// call before glfwTerminate
+	void stop() { streamer.stop(); }
+
+private:
+	friend class Texture2D;
+	TextureStreamer streamer;
+	TextureResidency resident;
+	std::unordered_map<std::string, TextureStreamer::Handle> paths;
+
+	void release(TextureStreamer::Handle handle);
+};
+
+TextureManager::TextureManager(unsigned int workerCount, UploadScheduler* scheduler, size_t budgetBytes)
+	: streamer(workerCount, scheduler), resident(streamer, budgetBytes)
+{
+}
+
+void TextureManager::update()
+{
+	streamer.update();
+	resident.update();
+}
+
+Texture2D TextureManager::load(const std::string& path, int priority)
+{
+	auto loaded = paths.find(path);
+	if (loaded != paths.end())
+	{
+		streamer.acquire(loaded->second);
+		return Texture2D(this, loaded->second);
+	}
+	TextureStreamer::Handle handle = streamer.request(path, priority);
+	paths[path] = handle;
+	resident.track(handle);
+	return Texture2D(this, handle);
+}
+
+void TextureManager::release(TextureStreamer::Handle handle)
+{
+	if (!streamer.release(handle))
+		return;
+	resident.untrack(handle);
+	for (auto it = paths.begin(); it != paths.end(); ++it)
+	{
+		if (it->second == handle)
+		{
+			paths.erase(it);
+			break;
+		}
+	}
+}
+
+
+Texture2D::Texture2D(const Texture2D& other) : manager(other.manager), handle(other.handle)
+{
+	if (manager)
+		manager->streamer.acquire(handle);
+}
+
+Texture2D::Texture2D(Texture2D&& other) : manager(other.manager), handle(other.handle)
+{
+	other.manager = nullptr;
+}
+
+Texture2D& Texture2D::operator=(Texture2D other)
+{
+	std::swap(manager, other.manager);
+	std::swap(handle, other.handle);
+	return *this;
+}
+
+Texture2D::~Texture2D()
+{
+	reset();
+}
+
+unsigned int Texture2D::id() const
+{
+	return manager ? manager->resident.use(handle) : 0;
+}
+
+bool Texture2D::isReady() const
+{
+	return manager && manager->streamer.isReady(handle);
+}
+
+void Texture2D::reset()
+{
+	if (manager)
+		manager->release(handle);
+	manager = nullptr;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include "texture_streamer.h"
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+
+// keeps the textures of a TextureStreamer within a GPU memory budget, so a
+// big set of images doesn't make the driver page. the bytes are every mip
+// level of every loaded texture. what's in use comes from use(), which the
+// render loop calls for each texture it binds (Texture2D::id does): when over
+// budget, the textures used longest ago are evicted first, and streamed in
+// again the next time use() asks for them. textures used in the last frame
+// are never evicted, when they alone are over the budget it stays that way
+class TextureResidency {
+public:
+	struct Stats {
+		size_t residentBytes;
+		size_t budgetBytes;
+		unsigned int evicted;    // by the last update()
+		unsigned int restreamed; // by use() since the update() before
+	};
+
+	// a budget of 0 only counts the bytes, nothing is evicted
+	TextureResidency(TextureStreamer& streamer, size_t budgetBytes = 0);
+
+	void setBudget(size_t budgetBytes) { this->budgetBytes = budgetBytes; }
+	size_t budget() const { return budgetBytes; }
+
+	// handles of the streamer to manage, untrack them before they're released
+	void track(TextureStreamer::Handle handle);
+	void untrack(TextureStreamer::Handle handle);
+
+	// the texture to bind for handle, and marks it used this frame. an evicted
+	// one is streamed in again and this is the placeholder until it's back
+	unsigned int use(TextureStreamer::Handle handle);
+
+	// call once a frame after TextureStreamer::update, before drawing
+	void update();
+	const Stats& lastFrameStats() const { return lastFrame; }
+
+private:
+	TextureStreamer& streamer;
+	size_t budgetBytes;
+	std::vector<TextureStreamer::Handle> handles;
+	// frame each handle was last used, indexed by handle (they're dense)
+	std::vector<uint64_t> lastUsed;
+	uint64_t frame = 0;
+	unsigned int restreamed = 0;
+	Stats lastFrame;
+};
+
+TextureResidency::TextureResidency(TextureStreamer& streamer, size_t budgetBytes)
+	: streamer(streamer), budgetBytes(budgetBytes), lastFrame{ 0, budgetBytes, 0, 0 }
+{
+}
+
+void TextureResidency::track(TextureStreamer::Handle handle)
+{
+	handles.push_back(handle);
+	if (lastUsed.size() <= handle)
+		lastUsed.resize(handle + 1, 0);
+	lastUsed[handle] = frame;
+}
+
+void TextureResidency::untrack(TextureStreamer::Handle handle)
+{
+	handles.erase(std::remove(handles.begin(), handles.end(), handle), handles.end());
+}
+
+unsigned int TextureResidency::use(TextureStreamer::Handle handle)
+{
+	if (handle < lastUsed.size())
+		lastUsed[handle] = frame;
+	if (streamer.isEvicted(handle))
+	{
+		streamer.restream(handle);
+		restreamed++;
+	}
+	return streamer.texture(handle);
+}
+
+void TextureResidency::update()
+{
+	frame++;
+
+	// loaded textures with the latest use of any handle sharing them. one
+	// still loading counts as used, so it isn't evicted the moment it's in
+	std::unordered_map<unsigned int, std::pair<uint64_t, TextureStreamer::Handle>> resident;
+	for (TextureStreamer::Handle handle : handles)
+	{
+		if (!streamer.isReady(handle))
+		{
+			lastUsed[handle] = frame;
+			continue;
+		}
+		auto inserted = resident.insert(std::make_pair(streamer.texture(handle),
+			std::make_pair(lastUsed[handle], handle)));
+		if (!inserted.second && inserted.first->second.first < lastUsed[handle])
+			inserted.first->second = std::make_pair(lastUsed[handle], handle);
+	}
+
+	size_t bytes = streamer.gpuBytes();
+	unsigned int evicted = 0;
+	if (budgetBytes && bytes > budgetBytes)
+	{
+		// least recently used first, skipping what the last frame drew with
+		std::vector<std::pair<uint64_t, TextureStreamer::Handle>> candidates;
+		for (auto& texture : resident)
+		{
+			if (texture.second.first + 1 < frame)
+				candidates.push_back(texture.second);
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (auto& candidate : candidates)
+		{
+			if (bytes <= budgetBytes)
+				break;
+			size_t textureBytes = streamer.info(candidate.second).gpuBytes;
+			if (!streamer.evict(candidate.second))
+				continue;
+			bytes -= textureBytes;
+			evicted++;
+		}
+	}
+
+	lastFrame = Stats{ bytes, budgetBytes, evicted, restreamed };
+	restreamed = 0;
+}
+
+#endif
@@ -0,0 +1,666 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include "gl_features.h"
+#include "gl_state.h"
+#include "texture.h"
+#include "block_compress.h"
+#include "upload_scheduler.h"
+#include "hash.h"
+#include "stb_image.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+
+// loads textures without holding up the render loop. worker threads read and
+// decode the files, the GL thread only maps a pixel unpack buffer (PBO) for
+// each image, which the worker decodes into, and then creates the texture
+// from it. until then texture() returns a placeholder, so the first frame
+// doesn't wait for any image. with an UploadScheduler the pixels go up within
+// its per-frame budget, otherwise all at once.
+// files with identical bytes share one texture, decoded and uploaded once.
+// every request holds a reference, the texture is deleted as soon as the
+// last one is released.
+// optionally the workers block compress the images (BC1, or BC3 with alpha)
+// with a CPU built mip chain, which is 4-8x less GPU memory and upload, and
+// keep the result in a disk cache so it's only encoded once
+class TextureStreamer {
+public:
+	typedef size_t Handle;
+
+	// starts the workers and creates the placeholder, call on the GL thread.
+	// scheduler (optional) must outlive stop()
+	explicit TextureStreamer(unsigned int workerCount = 2, UploadScheduler* scheduler = nullptr);
+	~TextureStreamer();
+
+	// for the textures requested after this, if the GL has S3TC. with a
+	// cacheDirectory (which must exist) the compressed images are kept there
+	void enableCompression(const std::string& cacheDirectory = "");
+
+	// higher priorities are uploaded first when there's a scheduler
+	Handle request(const std::string& path, int priority = 0);
+
+	// another reference to the same texture
+	void acquire(Handle handle);
+	// returns true when that was the last reference and the texture is gone
+	bool release(Handle handle);
+
+	// deletes the texture but keeps the references, texture() is the placeholder
+	// until restream() loads it again. false if it isn't loaded
+	bool evict(Handle handle);
+	void restream(Handle handle);
+	bool isEvicted(Handle handle) const { return resolve(handle).evicted; }
+
+	// call once a frame on the GL thread: maps buffers for images whose size
+	// is known and turns decoded ones into textures
+	void update();
+
+	// the placeholder until the image is in (or failed to load)
+	unsigned int texture(Handle handle) const { return resolve(handle).texture.ID; }
+	bool isReady(Handle handle) const { return resolve(handle).ready; }
+	// size and GPU bytes, once ready
+	const TextureInfo& info(Handle handle) const { return resolve(handle).texture; }
+	size_t pendingCount() const { return pending; }
+	// of all textures currently loaded, shared ones counted once
+	size_t gpuBytes() const;
+
+	// joins the workers, cancels its uploads still in the scheduler and deletes
+	// the buffers and textures. call before glfwTerminate
+	void stop();
+
+private:
+	enum class State { Reading, NeedsBuffer, Decoding, Decoded, Failed };
+	// owned by whoever has it queued: a worker in jobs, the GL thread in finished
+	struct Entry {
+		std::string path;
+		int priority;
+		State state;
+		// encoded bytes. kept while the entry is alive, so an entry with the same
+		// hash is only shared after comparing them, and evicted textures don't
+		// need the file read again. the GL thread frees them, the workers read
+		std::vector<unsigned char> file;
+		uint64_t contentHash;            // of file
+		int width, height, nrChannels;
+		bool compressed;    // pixelBuffer holds the blocks of every mip level
+		BlockFormat format;
+		std::string cacheDirectory; // of compressed images, empty for none
+		unsigned int pixelBuffer;
+		void* mapped;
+		// GL thread only
+		TextureInfo texture;
+		TextureInfo uploading; // allocated, filled by the scheduler
+		UploadScheduler::Ticket upload; // while the scheduler has it, else 0
+		bool ready;
+		unsigned int references;
+		Entry* source;   // entry with the same bytes whose texture this one shares
+		bool released;   // no references left, dropped once it's back from the workers
+		bool evicted;    // texture deleted to save memory, until restreamed
+	};
+
+	std::vector<std::unique_ptr<Entry>> entries;
+	TextureInfo placeholder;
+	UploadScheduler* scheduler;
+	std::unordered_map<uint64_t, Entry*> contents; // content hash -> entry owning the texture
+	size_t pending = 0;
+	bool stopped = false;
+	bool compress = false;
+	std::string cacheDirectory; // copied into every entry, the workers only read those
+
+	std::vector<std::thread> workers;
+	std::mutex mutex; // guards the two queues and stopping
+	std::condition_variable wake;
+	std::deque<Entry*> jobs;      // Reading or Decoding, for the workers
+	std::vector<Entry*> finished; // NeedsBuffer, Decoded or Failed, for the GL thread
+	bool stopping = false;
+
+	void run();
+	static void read(Entry& entry);
+	void decode(Entry& entry);
+	// the whole chain into the mapped buffer, from the cache or encoded now
+	bool decodeCompressed(Entry& entry);
+	static std::string compressedCachePath(const Entry& entry);
+	static bool loadCompressed(const Entry& entry, std::vector<unsigned char>& blocks);
+	static void saveCompressed(const Entry& entry, const std::vector<unsigned char>& blocks);
+	static size_t pixelBufferSize(const Entry& entry);
+	void queue(Entry* entry);
+	void mapPixelBuffer(Entry& entry);
+	void createTexture(Entry& entry);
+	void finishTexture(Entry& entry);
+	void deletePixelBuffer(Entry& entry);
+	void share(Entry& entry, Entry& source);
+	void failEntry(Entry& entry);
+	bool releaseEntry(Entry& entry);
+	void deleteTexture(unsigned int texture);
+	const Entry& resolve(Handle handle) const;
+	Entry& resolve(Handle handle);
+};
+
+TextureStreamer::TextureStreamer(unsigned int workerCount, UploadScheduler* scheduler)
+	: scheduler(scheduler)
+{
+	// grey/white checkers, obviously not the real image
+	const unsigned char checkers[] = { 96, 160, 160, 96 };
+	this->placeholder = createTexture2D(checkers, 2, 2, 1);
+
+	for (unsigned int i = 0; i < (workerCount ? workerCount : 1); i++)
+		workers.push_back(std::thread(&TextureStreamer::run, this));
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	stop();
+}
+
+void TextureStreamer::enableCompression(const std::string& cacheDirectory)
+{
+	if (!GLHasTextureCompressionS3TC())
+	{
+		std::cout << "ERROR::TEXTURE::S3TC_NOT_SUPPORTED" << std::endl;
+		return;
+	}
+	this->compress = true;
+	this->cacheDirectory = cacheDirectory;
+}
+
+TextureStreamer::Handle TextureStreamer::request(const std::string& path, int priority)
+{
+	std::unique_ptr<Entry> entry(new Entry());
+	entry->path = path;
+	entry->priority = priority;
+	entry->state = State::Reading;
+	entry->contentHash = 0;
+	entry->compressed = this->compress;
+	entry->format = BlockFormat::BC1;
+	entry->cacheDirectory = this->cacheDirectory;
+	entry->pixelBuffer = 0;
+	entry->mapped = NULL;
+	entry->texture = this->placeholder;
+	entry->uploading.ID = 0;
+	entry->upload = 0;
+	entry->ready = false;
+	entry->references = 1;
+	entry->source = nullptr;
+	entry->released = false;
+	entry->evicted = false;
+	entries.push_back(std::move(entry));
+	pending++;
+	queue(entries.back().get());
+	return entries.size() - 1;
+}
+
+void TextureStreamer::acquire(Handle handle)
+{
+	entries[handle]->references++;
+}
+
+bool TextureStreamer::release(Handle handle)
+{
+	if (stopped)
+		return false; // everything is deleted already
+	return releaseEntry(*entries[handle]);
+}
+
+bool TextureStreamer::evict(Handle handle)
+{
+	Entry& entry = resolve(handle);
+	if (this->stopped || !entry.ready)
+		return false;
+	deleteTexture(entry.texture.ID);
+	entry.texture = this->placeholder;
+	entry.ready = false;
+	entry.evicted = true;
+	std::cout << "texture evicted: " << entry.path << std::endl;
+	return true;
+}
+
+void TextureStreamer::restream(Handle handle)
+{
+	Entry& entry = resolve(handle);
+	if (this->stopped || !entry.evicted)
+		return;
+	entry.evicted = false;
+	pending++;
+	// the bytes are still here, straight to decoding
+	mapPixelBuffer(entry);
+}
+
+size_t TextureStreamer::gpuBytes() const
+{
+	size_t bytes = 0;
+	for (auto& entry : entries)
+	{
+		if (entry->ready && !entry->source)
+			bytes += entry->texture.gpuBytes;
+	}
+	return bytes;
+}
+
+const TextureStreamer::Entry& TextureStreamer::resolve(Handle handle) const
+{
+	const Entry* entry = entries[handle].get();
+	return entry->source ? *entry->source : *entry;
+}
+
+TextureStreamer::Entry& TextureStreamer::resolve(Handle handle)
+{
+	Entry* entry = entries[handle].get();
+	return entry->source ? *entry->source : *entry;
+}
+
+void TextureStreamer::update()
+{
+	std::vector<Entry*> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(finished);
+	}
+
+	for (Entry* entry : done)
+	{
+		if (entry->released)
+		{
+			deletePixelBuffer(*entry);
+			std::vector<unsigned char>().swap(entry->file);
+			pending--;
+			continue;
+		}
+		switch (entry->state)
+		{
+		case State::NeedsBuffer:
+		{
+			auto same = contents.find(entry->contentHash);
+			if (same == contents.end())
+				contents[entry->contentHash] = entry;
+			else if (same->second->file == entry->file)
+			{
+				share(*entry, *same->second);
+				break;
+			}
+			else
+			{
+				// only the hash matches, load it on its own
+				std::cout << "ERROR::TEXTURE::CONTENT_HASH_COLLISION\n" << entry->path <<
+					" = " << same->second->path << std::endl;
+			}
+			mapPixelBuffer(*entry);
+			break;
+		}
+		case State::Decoded:
+			createTexture(*entry);
+			break;
+		default:
+			std::cout << "ERROR::TEXTURE::STREAM_FAILED\n" << entry->path << std::endl;
+			failEntry(*entry);
+			break;
+		}
+	}
+}
+
+void TextureStreamer::stop()
+{
+	if (stopped)
+		return;
+	stopped = true;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+
+	for (auto& entry : entries)
+	{
+		// the scheduler would write into the deleted names and call back into the entry
+		if (entry->upload)
+			this->scheduler->cancel(entry->upload);
+		entry->upload = 0;
+		deletePixelBuffer(*entry);
+		if (entry->ready && !entry->source)
+			deleteTexture(entry->texture.ID);
+		if (entry->uploading.ID)
+			deleteTexture(entry->uploading.ID);
+	}
+	deleteTexture(this->placeholder.ID);
+}
+
+void TextureStreamer::run()
+{
+	for (;;)
+	{
+		Entry* entry;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+				return;
+			entry = jobs.front();
+			jobs.pop_front();
+		}
+
+		if (entry->state == State::Reading)
+			read(*entry);
+		else
+			decode(*entry);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.push_back(entry);
+	}
+}
+
+// the whole file, and the image size from its header, so the GL thread
+// can size the pixel buffer
+void TextureStreamer::read(Entry& entry)
+{
+	std::ifstream file(entry.path, std::ios::binary | std::ios::ate);
+	std::streamoff size = file ? (std::streamoff)file.tellg() : -1;
+	if (size <= 0)
+	{
+		entry.state = State::Failed;
+		return;
+	}
+	entry.file.resize((size_t)size);
+	file.seekg(0);
+	file.read((char*)entry.file.data(), size);
+	entry.contentHash = hashBytes(HASH_BYTES_SEED, (const char*)entry.file.data(), entry.file.size());
+
+	if (!file || !stbi_info_from_memory(entry.file.data(), (int)entry.file.size(),
+		&entry.width, &entry.height, &entry.nrChannels))
+	{
+		entry.state = State::Failed;
+		return;
+	}
+	entry.format = entry.nrChannels == 2 || entry.nrChannels == 4 ? BlockFormat::BC3 : BlockFormat::BC1;
+	entry.state = State::NeedsBuffer;
+}
+
+// into the mapped pixel buffer, no GL calls here
+void TextureStreamer::decode(Entry& entry)
+{
+	if (entry.compressed)
+	{
+		entry.state = decodeCompressed(entry) ? State::Decoded : State::Failed;
+		return;
+	}
+	int width, height, nrChannels;
+	unsigned char* data = stbi_load_from_memory(entry.file.data(), (int)entry.file.size(),
+		&width, &height, &nrChannels, entry.nrChannels);
+	if (!data || width != entry.width || height != entry.height)
+	{
+		stbi_image_free(data);
+		entry.state = State::Failed;
+		return;
+	}
+	memcpy(entry.mapped, data, (size_t)width * height * entry.nrChannels);
+	stbi_image_free(data);
+	entry.state = State::Decoded;
+}
+
+bool TextureStreamer::decodeCompressed(Entry& entry)
+{
+	std::vector<unsigned char> blocks;
+	if (!loadCompressed(entry, blocks))
+	{
+		int width, height, nrChannels;
+		// always 4 channels, grey is spread over RGB
+		unsigned char* data = stbi_load_from_memory(entry.file.data(), (int)entry.file.size(),
+			&width, &height, &nrChannels, 4);
+		if (!data || width != entry.width || height != entry.height)
+		{
+			stbi_image_free(data);
+			return false;
+		}
+		blocks = compressMipChain(data, width, height, entry.format);
+		stbi_image_free(data);
+		saveCompressed(entry, blocks);
+	}
+	// written once in one go, the buffer may be write combined memory
+	memcpy(entry.mapped, blocks.data(), blocks.size());
+	return true;
+}
+
+std::string TextureStreamer::compressedCachePath(const Entry& entry)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx.bc%d", (unsigned long long)entry.contentHash,
+		entry.format == BlockFormat::BC1 ? 1 : 3);
+	return entry.cacheDirectory + "/" + fileName;
+}
+
+// cache file layout: magic, format, content hash, size, length, then the blocks
+struct CompressedTextureHeader {
+	uint32_t magic;
+	uint32_t format;
+	uint64_t key;
+	int32_t width, height;
+	uint32_t length;
+};
+constexpr uint32_t COMPRESSED_TEXTURE_MAGIC = 0x58544342; // "BCTX"
+
+bool TextureStreamer::loadCompressed(const Entry& entry, std::vector<unsigned char>& blocks)
+{
+	if (entry.cacheDirectory.empty())
+		return false;
+	std::ifstream file(compressedCachePath(entry), std::ios::binary);
+	if (!file)
+		return false;
+
+	CompressedTextureHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.magic != COMPRESSED_TEXTURE_MAGIC ||
+		header.format != (uint32_t)entry.format || header.key != entry.contentHash ||
+		header.width != entry.width || header.height != entry.height ||
+		header.length != blockChainBytes(entry.width, entry.height, entry.format))
+		return false;
+	blocks.resize(header.length);
+	return (bool)file.read((char*)blocks.data(), blocks.size());
+}
+
+void TextureStreamer::saveCompressed(const Entry& entry, const std::vector<unsigned char>& blocks)
+{
+	if (entry.cacheDirectory.empty())
+		return;
+	std::ofstream file(compressedCachePath(entry), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ERROR::TEXTURE::COMPRESSED_CACHE::WRITE_FAILED\n" <<
+			compressedCachePath(entry) << std::endl;
+		return;
+	}
+	CompressedTextureHeader header{ COMPRESSED_TEXTURE_MAGIC, (uint32_t)entry.format, entry.contentHash,
+		entry.width, entry.height, (uint32_t)blocks.size() };
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)blocks.data(), blocks.size());
+}
+
+size_t TextureStreamer::pixelBufferSize(const Entry& entry)
+{
+	if (entry.compressed)
+		return blockChainBytes(entry.width, entry.height, entry.format);
+	return (size_t)entry.width * entry.height * entry.nrChannels;
+}
+
+void TextureStreamer::queue(Entry* entry)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(entry);
+	}
+	wake.notify_one();
+}
+
+void TextureStreamer::mapPixelBuffer(Entry& entry)
+{
+	size_t size = pixelBufferSize(entry);
+	glGenBuffers(1, &entry.pixelBuffer);
+	GLStateCache::get().bindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	entry.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	GLStateCache::get().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (entry.mapped == NULL)
+	{
+		std::cout << "ERROR::TEXTURE::STREAM_MAP_FAILED\n" << entry.path << std::endl;
+		failEntry(entry);
+		return;
+	}
+	entry.state = State::Decoding;
+	queue(&entry);
+}
+
+void TextureStreamer::createTexture(Entry& entry)
+{
+	GLStateCache& glState = GLStateCache::get();
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.pixelBuffer);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	entry.mapped = NULL;
+
+	if (entry.compressed)
+	{
+		// a few times smaller, so it goes up at once, outside the scheduler
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.pixelBuffer);
+		entry.uploading = createCompressedTexture2D(entry.format, NULL, entry.width, entry.height);
+		glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		finishTexture(entry);
+		return;
+	}
+	entry.uploading = allocateTexture2D(entry.width, entry.height, entry.nrChannels);
+
+	if (this->scheduler)
+	{
+		// the pixels "pointer" is an offset into the buffer
+		Entry* pending = &entry;
+		entry.upload = this->scheduler->uploadTexture(entry.uploading.ID, 0, entry.width, entry.height,
+			entry.nrChannels, entry.pixelBuffer, NULL, entry.priority,
+			[this, pending] { finishTexture(*pending); });
+		return;
+	}
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, entry.pixelBuffer);
+	setUnpackAlignment(entry.width, entry.nrChannels);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height,
+		texturePixelFormat(entry.nrChannels), GL_UNSIGNED_BYTE, NULL);
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	finishTexture(entry);
+}
+
+// level 0 is in (every level when compressed), fill the mip chain and swap
+// it in for the placeholder
+void TextureStreamer::finishTexture(Entry& entry)
+{
+	entry.upload = 0;
+	if (entry.released)
+	{
+		// nobody wants it anymore
+		deleteTexture(entry.uploading.ID);
+		entry.uploading.ID = 0;
+		deletePixelBuffer(entry);
+		std::vector<unsigned char>().swap(entry.file);
+		pending--;
+		return;
+	}
+	// compressed ones come with their levels
+	if (!entry.compressed)
+	{
+		GLStateCache::get().bindTexture(0, GL_TEXTURE_2D, entry.uploading.ID);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	deletePixelBuffer(entry);
+	entry.texture = entry.uploading;
+	entry.uploading.ID = 0;
+	entry.ready = true;
+	pending--;
+	std::cout << "texture loaded: " << entry.path << " (" << entry.texture.gpuBytes
+		<< " bytes)" << std::endl;
+}
+
+// same bytes as source: no decode or upload, just a reference to its texture
+void TextureStreamer::share(Entry& entry, Entry& source)
+{
+	std::vector<unsigned char>().swap(entry.file);
+	entry.source = &source;
+	source.references++;
+	pending--;
+	std::cout << "texture shared: " << entry.path << " = " << source.path << std::endl;
+}
+
+bool TextureStreamer::releaseEntry(Entry& entry)
+{
+	if (entry.references == 0 || --entry.references > 0)
+		return false;
+	if (entry.source)
+	{
+		Entry* source = entry.source;
+		entry.source = nullptr;
+		entry.texture = this->placeholder;
+		releaseEntry(*source);
+		return true;
+	}
+
+	if (contents.count(entry.contentHash) && contents[entry.contentHash] == &entry)
+		contents.erase(entry.contentHash);
+	entry.released = true;
+	if (entry.ready || entry.evicted)
+		std::vector<unsigned char>().swap(entry.file); // no worker has it
+	if (entry.ready)
+	{
+		deleteTexture(entry.texture.ID);
+		entry.texture = this->placeholder;
+		entry.ready = false;
+	}
+	// still being read, decoded or uploaded: dropped once it comes back
+	return true;
+}
+
+// entries sharing its texture are detached and requested again on their own,
+// the same bytes may still load (e.g. after a failed buffer map)
+void TextureStreamer::failEntry(Entry& entry)
+{
+	if (contents.count(entry.contentHash) && contents[entry.contentHash] == &entry)
+		contents.erase(entry.contentHash);
+	deletePixelBuffer(entry);
+	std::vector<unsigned char>().swap(entry.file);
+	pending--;
+
+	for (auto& other : entries)
+	{
+		if (other->source != &entry)
+			continue;
+		other->source = nullptr;
+		entry.references--;
+		other->state = State::Reading;
+		pending++;
+		queue(other.get());
+	}
+}
+
+void TextureStreamer::deleteTexture(unsigned int texture)
+{
+	GLStateCache::get().forgetTexture(texture);
+	glDeleteTextures(1, &texture);
+}
+
+void TextureStreamer::deletePixelBuffer(Entry& entry)
+{
+	if (entry.pixelBuffer == 0)
+		return;
+	GLStateCache::get().forgetBuffer(entry.pixelBuffer);
+	glDeleteBuffers(1, &entry.pixelBuffer); // also unmaps
+	entry.pixelBuffer = 0;
+	entry.mapped = NULL;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef TRANSFORM2D_H
+#define TRANSFORM2D_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "instance_buffer.h"
+
+#include <cmath>
+
+
+// 2D affine transform (translation, rotation around z, xy scale/shear) in 6
+// floats instead of a 16 float mat4. stored as the top two rows of the 3x3
+// matrix: { a, c, tx } and { b, d, ty }, which is what the shader dots with
+// (x, y, 1)
+struct Affine2D {
+	float m[6];
+
+	static Affine2D identity() { return Affine2D{ { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f } }; }
+
+	// same order as glm: each applies before the transform it's called on
+	Affine2D translate(float x, float y) const;
+	Affine2D rotate(float angle) const;
+	Affine2D scale(float x, float y) const;
+
+	Affine2D operator*(const Affine2D& other) const;
+	glm::mat4 toMat4() const;
+};
+
+Affine2D Affine2D::translate(float x, float y) const
+{
+	return *this * Affine2D{ { 1.0f, 0.0f, x, 0.0f, 1.0f, y } };
+}
+
+Affine2D Affine2D::rotate(float angle) const
+{
+	float c = cos(angle), s = sin(angle);
+	return *this * Affine2D{ { c, -s, 0.0f, s, c, 0.0f } };
+}
+
+Affine2D Affine2D::scale(float x, float y) const
+{
+	return *this * Affine2D{ { x, 0.0f, 0.0f, 0.0f, y, 0.0f } };
+}
+
+Affine2D Affine2D::operator*(const Affine2D& o) const
+{
+	return Affine2D{ {
+		m[0] * o.m[0] + m[1] * o.m[3], m[0] * o.m[1] + m[1] * o.m[4], m[0] * o.m[2] + m[1] * o.m[5] + m[2],
+		m[3] * o.m[0] + m[4] * o.m[3], m[3] * o.m[1] + m[4] * o.m[4], m[3] * o.m[2] + m[4] * o.m[5] + m[5],
+	} };
+}
+
+glm::mat4 Affine2D::toMat4() const
+{
+	glm::mat4 result(1.0f);
+	result[0][0] = m[0]; result[1][0] = m[1]; result[3][0] = m[2];
+	result[0][1] = m[3]; result[1][1] = m[4]; result[3][1] = m[5];
+	return result;
+}
+
+// two vec3 rows per instance, 24 bytes against 64 for a mat4
+template <> struct InstanceAttributes<Affine2D> {
+	static constexpr unsigned int locationCount = 2;
+	static void point(unsigned int location, size_t offset)
+	{
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(Affine2D), (void*)offset);
+		glVertexAttribPointer(location + 1, 3, GL_FLOAT, GL_FALSE, sizeof(Affine2D),
+			(void*)(offset + 3 * sizeof(float)));
+	}
+};
+
+#endif
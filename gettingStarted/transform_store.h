@@ -0,0 +1,213 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include "transform2d.h"
+
+#include <vector>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_STORE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+// 2D transforms of many objects as separate arrays (structure of arrays), so
+// compute() can turn 4 (SSE2) or 8 (AVX2) of them into Affine2D matrices at
+// once: M = translate * rotate * scale, what the glm calls used to build.
+// angles go through a polynomial sin/cos, keep them within a few thousand
+// radians (wrap them with fmod) or precision drops
+class TransformStore {
+public:
+	std::vector<float> posX, posY;
+	std::vector<float> angle;
+	std::vector<float> scaleX, scaleY;
+
+	// returns the index of the new object
+	size_t add(float x, float y, float angle = 0.0f, float scaleX = 1.0f, float scaleY = 1.0f);
+	size_t size() const { return posX.size(); }
+	void clear();
+
+	// writes size() matrices, e.g. into a mapped InstanceBuffer
+	void compute(Affine2D* out) const;
+
+private:
+	void computeScalar(size_t begin, size_t end, Affine2D* out) const;
+#ifdef TRANSFORM_STORE_SSE2
+	static void sincos4(__m128 x, __m128& s, __m128& c);
+	static void store4(float* out, __m128 a, __m128 c, __m128 tx, __m128 b, __m128 d, __m128 ty);
+	size_t computeSse2(size_t begin, size_t end, Affine2D* out) const;
+#endif
+#ifdef __AVX2__
+	static void sincos8(__m256 x, __m256& s, __m256& c);
+	size_t computeAvx2(size_t begin, size_t end, Affine2D* out) const;
+#endif
+};
+
+size_t TransformStore::add(float x, float y, float angle, float scaleX, float scaleY)
+{
+	this->posX.push_back(x);
+	this->posY.push_back(y);
+	this->angle.push_back(angle);
+	this->scaleX.push_back(scaleX);
+	this->scaleY.push_back(scaleY);
+	return this->posX.size() - 1;
+}
+
+void TransformStore::clear()
+{
+	posX.clear();
+	posY.clear();
+	angle.clear();
+	scaleX.clear();
+	scaleY.clear();
+}
+
+void TransformStore::compute(Affine2D* out) const
+{
+	size_t done = 0;
+#ifdef __AVX2__
+	done = computeAvx2(done, size(), out);
+#endif
+#ifdef TRANSFORM_STORE_SSE2
+	done = computeSse2(done, size(), out);
+#endif
+	computeScalar(done, size(), out);
+}
+
+void TransformStore::computeScalar(size_t begin, size_t end, Affine2D* out) const
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		float c = cos(angle[i]), s = sin(angle[i]);
+		out[i] = Affine2D{ {
+			c * scaleX[i], -s * scaleY[i], posX[i],
+			s * scaleX[i],  c * scaleY[i], posY[i],
+		} };
+	}
+}
+
+#ifdef TRANSFORM_STORE_SSE2
+
+// cephes sinf/cosf: reduce to [-pi/4, pi/4] around the nearest multiple of
+// pi/2, evaluate both polynomials, then swap and flip signs by quadrant
+void TransformStore::sincos4(__m128 x, __m128& s, __m128& c)
+{
+	__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f))); // x * 2/pi, rounded
+	__m128 qf = _mm_cvtepi32_ps(q);
+	// pi/2 in three parts so the subtraction stays exact
+	x = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(4.837512969970703125e-4f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(qf, _mm_set1_ps(7.54978995489188216e-8f)));
+
+	__m128 x2 = _mm_mul_ps(x, x);
+	__m128 sp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), x2), _mm_set1_ps(8.3321608736e-3f));
+	sp = _mm_add_ps(_mm_mul_ps(sp, x2), _mm_set1_ps(-1.6666654611e-1f));
+	sp = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sp, x2), x), x);
+	__m128 cp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), x2), _mm_set1_ps(-1.388731625493765e-3f));
+	cp = _mm_add_ps(_mm_mul_ps(cp, x2), _mm_set1_ps(4.166664568298827e-2f));
+	cp = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cp, x2), x2), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, _mm_set1_ps(0.5f))));
+
+	// odd quadrants swap sin and cos
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	s = _mm_or_ps(_mm_and_ps(swap, cp), _mm_andnot_ps(swap, sp));
+	c = _mm_or_ps(_mm_and_ps(swap, sp), _mm_andnot_ps(swap, cp));
+	// sin is negative in quadrants 2-3, cos in 1-2
+	__m128i two = _mm_set1_epi32(2);
+	s = _mm_xor_ps(s, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30)));
+	c = _mm_xor_ps(c, _mm_castsi128_ps(_mm_slli_epi32(
+		_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), two), 30)));
+}
+
+// 4 matrices given as one register per element, interleaved to 24 floats
+void TransformStore::store4(float* out, __m128 a, __m128 c, __m128 tx, __m128 b, __m128 d, __m128 ty)
+{
+	_MM_TRANSPOSE4_PS(a, c, tx, b); // now a c tx b of one matrix per register
+	__m128 low = _mm_unpacklo_ps(d, ty);  // d0 ty0 d1 ty1
+	__m128 high = _mm_unpackhi_ps(d, ty); // d2 ty2 d3 ty3
+	_mm_storeu_ps(out, a);
+	_mm_storeu_ps(out + 4, _mm_movelh_ps(low, c));
+	_mm_storeu_ps(out + 8, _mm_movehl_ps(low, c));
+	_mm_storeu_ps(out + 12, tx);
+	_mm_storeu_ps(out + 16, _mm_movelh_ps(high, b));
+	_mm_storeu_ps(out + 20, _mm_movehl_ps(high, b));
+}
+
+// returns how far it got, the rest is left for a narrower kernel
+size_t TransformStore::computeSse2(size_t begin, size_t end, Affine2D* out) const
+{
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 s, c;
+		sincos4(_mm_loadu_ps(&angle[i]), s, c);
+		__m128 sx = _mm_loadu_ps(&scaleX[i]);
+		__m128 sy = _mm_loadu_ps(&scaleY[i]);
+		store4(out[i].m, _mm_mul_ps(c, sx), _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s, sy)),
+			_mm_loadu_ps(&posX[i]), _mm_mul_ps(s, sx), _mm_mul_ps(c, sy), _mm_loadu_ps(&posY[i]));
+	}
+	return i;
+}
+
+#endif
+
+#ifdef __AVX2__
+
+// sincos4 on 8 lanes
+void TransformStore::sincos8(__m256 x, __m256& s, __m256& c)
+{
+	__m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772f)));
+	__m256 qf = _mm256_cvtepi32_ps(q);
+	x = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(1.5703125f)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(4.837512969970703125e-4f)));
+	x = _mm256_sub_ps(x, _mm256_mul_ps(qf, _mm256_set1_ps(7.54978995489188216e-8f)));
+
+	__m256 x2 = _mm256_mul_ps(x, x);
+	__m256 sp = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), x2), _mm256_set1_ps(8.3321608736e-3f));
+	sp = _mm256_add_ps(_mm256_mul_ps(sp, x2), _mm256_set1_ps(-1.6666654611e-1f));
+	sp = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sp, x2), x), x);
+	__m256 cp = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), x2), _mm256_set1_ps(-1.388731625493765e-3f));
+	cp = _mm256_add_ps(_mm256_mul_ps(cp, x2), _mm256_set1_ps(4.166664568298827e-2f));
+	cp = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(cp, x2), x2),
+		_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x2, _mm256_set1_ps(0.5f))));
+
+	__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+		_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	s = _mm256_blendv_ps(sp, cp, swap);
+	c = _mm256_blendv_ps(cp, sp, swap);
+	__m256i two = _mm256_set1_epi32(2);
+	s = _mm256_xor_ps(s, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, two), 30)));
+	c = _mm256_xor_ps(c, _mm256_castsi256_ps(_mm256_slli_epi32(
+		_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), two), 30)));
+}
+
+// the math runs 8 wide, the interleave reuses store4 on each 128-bit half
+size_t TransformStore::computeAvx2(size_t begin, size_t end, Affine2D* out) const
+{
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 s, c;
+		sincos8(_mm256_loadu_ps(&angle[i]), s, c);
+		__m256 sx = _mm256_loadu_ps(&scaleX[i]);
+		__m256 sy = _mm256_loadu_ps(&scaleY[i]);
+		__m256 a = _mm256_mul_ps(c, sx);
+		__m256 cc = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(s, sy));
+		__m256 tx = _mm256_loadu_ps(&posX[i]);
+		__m256 b = _mm256_mul_ps(s, sx);
+		__m256 d = _mm256_mul_ps(c, sy);
+		__m256 ty = _mm256_loadu_ps(&posY[i]);
+		store4(out[i].m, _mm256_castps256_ps128(a), _mm256_castps256_ps128(cc), _mm256_castps256_ps128(tx),
+			_mm256_castps256_ps128(b), _mm256_castps256_ps128(d), _mm256_castps256_ps128(ty));
+		store4(out[i + 4].m, _mm256_extractf128_ps(a, 1), _mm256_extractf128_ps(cc, 1), _mm256_extractf128_ps(tx, 1),
+			_mm256_extractf128_ps(b, 1), _mm256_extractf128_ps(d, 1), _mm256_extractf128_ps(ty, 1));
+	}
+	return i;
+}
+
+#endif
+
+#endif
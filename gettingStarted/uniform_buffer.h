@@ -0,0 +1,101 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "gl_state.h"
+
+#include <cstddef>
+
+
+// std140 base alignment and size of the types a block member may have.
+// anything else (arrays, mat3, bool) has no specialization and won't compile
+template <typename T> struct Std140;
+template <> struct Std140<float> { static constexpr size_t alignment = 4, size = 4; };
+template <> struct Std140<int> { static constexpr size_t alignment = 4, size = 4; };
+template <> struct Std140<unsigned int> { static constexpr size_t alignment = 4, size = 4; };
+template <> struct Std140<glm::vec2> { static constexpr size_t alignment = 8, size = 8; };
+template <> struct Std140<glm::vec3> { static constexpr size_t alignment = 16, size = 12; };
+template <> struct Std140<glm::vec4> { static constexpr size_t alignment = 16, size = 16; };
+template <> struct Std140<glm::mat4> { static constexpr size_t alignment = 16, size = 64; };
+
+// where std140 puts a member that follows one ending at previousEnd
+constexpr size_t std140Offset(size_t previousEnd, size_t alignment)
+{
+	return (previousEnd + alignment - 1) / alignment * alignment;
+}
+
+// put these after the block struct, one for every member in declaration
+// order: STD140_FIRST_MEMBER for the first, then STD140_MEMBER naming the
+// member before. each member must sit exactly where std140 places it after
+// the previous one, so missing and surplus padding both fail to compile
+#define STD140_FIRST_MEMBER(Block, member) \
+	static_assert(sizeof(Block::member) == Std140<decltype(Block::member)>::size && \
+		offsetof(Block, member) == 0, \
+		#Block "::" #member " is not at std140 offset 0")
+#define STD140_MEMBER(Block, member, previous) \
+	static_assert(sizeof(Block::member) == Std140<decltype(Block::member)>::size && \
+		offsetof(Block, member) == std140Offset(offsetof(Block, previous) + \
+			Std140<decltype(Block::previous)>::size, Std140<decltype(Block::member)>::alignment), \
+		#Block "::" #member " is not at its std140 offset after " #previous ", fix the padding before it")
+
+
+// a uniform block backed by its own buffer. edit `data` then upload() it in
+// one glBufferSubData instead of one glUniform* call per value
+template <typename T>
+class UniformBuffer {
+public:
+	static_assert(sizeof(T) % 16 == 0, "pad std140 block structs to a multiple of 16 bytes");
+
+	unsigned int ID;
+	unsigned int binding;
+	T data;
+
+	// allocates the buffer and attaches it to the binding point
+	explicit UniformBuffer(unsigned int binding);
+
+	// points the shader's block at this buffer's binding, checking its size
+	void bindTo(const Shader& shader, const char* blockName) const;
+
+	void upload() const;
+
+	// deletes the buffer, telling the state cache. call before glfwTerminate
+	void release();
+};
+
+template <typename T>
+UniformBuffer<T>::UniformBuffer(unsigned int binding) : binding(binding), data()
+{
+	glGenBuffers(1, &this->ID);
+	GLStateCache::get().bindBuffer(GL_UNIFORM_BUFFER, this->ID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+	GLStateCache::get().bindBufferBase(GL_UNIFORM_BUFFER, binding, this->ID);
+}
+
+template <typename T>
+void UniformBuffer<T>::bindTo(const Shader& shader, const char* blockName) const
+{
+	shader.bindUniformBlock(blockName, this->binding, sizeof(T));
+}
+
+template <typename T>
+void UniformBuffer<T>::upload() const
+{
+	GLStateCache::get().bindBuffer(GL_UNIFORM_BUFFER, this->ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &this->data);
+}
+
+template <typename T>
+void UniformBuffer<T>::release()
+{
+	if (this->ID)
+	{
+		GLStateCache::get().forgetBuffer(this->ID);
+		glDeleteBuffers(1, &this->ID);
+	}
+	this->ID = 0;
+}
+
+#endif
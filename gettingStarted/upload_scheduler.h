@@ -0,0 +1,234 @@
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "texture.h"
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+
+
+// spreads glTexSubImage2D/glBufferSubData work over frames. update() uploads
+// until the frame's byte or time budget is used up, cutting textures into
+// bands of rows and buffers into ranges, so a burst of finished assets costs
+// a few frames of steady work instead of one long one. the highest priority
+// goes first (e.g. what's visible), equal priorities in request order.
+// the time is what the GL calls take on the CPU, the GPU copies later
+class UploadScheduler {
+public:
+	typedef uint64_t Ticket;
+	// runs on the GL thread once the last byte is uploaded
+	typedef std::function<void()> DoneCallback;
+
+	struct Stats {
+		size_t queueDepth;    // uploads still waiting after the frame
+		size_t bytesUploaded;
+		unsigned int uploadsFinished;
+		double milliseconds;
+	};
+
+	UploadScheduler(size_t bytesPerFrame = 1 << 20, double millisecondsPerFrame = 2.0);
+
+	void setBudget(size_t bytesPerFrame, double millisecondsPerFrame);
+
+	// level of a 2D texture, rows tightly packed with nrChannels bytes per texel.
+	// read from pixelBuffer at offset (size_t)pixels when it isn't 0, so the
+	// buffer must stay alive (and unmapped) until done. otherwise pixels is copied
+	Ticket uploadTexture(unsigned int texture, int level, int width, int height, int nrChannels,
+		unsigned int pixelBuffer, const void* pixels, int priority = 0, DoneCallback done = nullptr);
+	// size bytes at offset in buffer, data is copied
+	Ticket uploadBuffer(GLenum target, unsigned int buffer, size_t offset, const void* data,
+		size_t size, int priority = 0, DoneCallback done = nullptr);
+
+	// e.g. when what the upload is for comes into view
+	void setPriority(Ticket ticket, int priority);
+	// drops an upload that isn't done, its callback never runs. for when the
+	// texture or buffer (or the pixel buffer) is about to be deleted
+	void cancel(Ticket ticket);
+
+	// call once a frame on the GL thread
+	void update();
+
+	size_t queueDepth() const { return jobs.size(); }
+	const Stats& lastFrameStats() const { return lastFrame; }
+
+private:
+	struct Job {
+		Ticket ticket;
+		int priority;
+		bool texture;
+		GLenum target;            // buffers only
+		unsigned int object;
+		int level, width, height, nrChannels;
+		unsigned int pixelBuffer;
+		size_t sourceOffset;      // into pixelBuffer, or the destination buffer offset
+		std::vector<unsigned char> data;
+		size_t size, uploaded;    // bytes
+		DoneCallback done;
+	};
+
+	size_t bytesPerFrame;
+	double millisecondsPerFrame;
+	std::vector<Job> jobs;
+	Ticket nextTicket = 1;
+	Stats lastFrame;
+
+	// uploads at most maxBytes of the job (at least one row), returns how many
+	size_t uploadSome(Job& job, size_t maxBytes);
+};
+
+UploadScheduler::UploadScheduler(size_t bytesPerFrame, double millisecondsPerFrame)
+	: bytesPerFrame(bytesPerFrame), millisecondsPerFrame(millisecondsPerFrame),
+	lastFrame{ 0, 0, 0, 0.0 }
+{
+}
+
+void UploadScheduler::setBudget(size_t bytesPerFrame, double millisecondsPerFrame)
+{
+	this->bytesPerFrame = bytesPerFrame;
+	this->millisecondsPerFrame = millisecondsPerFrame;
+}
+
+UploadScheduler::Ticket UploadScheduler::uploadTexture(unsigned int texture, int level, int width,
+	int height, int nrChannels, unsigned int pixelBuffer, const void* pixels, int priority, DoneCallback done)
+{
+	Job job;
+	job.ticket = nextTicket++;
+	job.priority = priority;
+	job.texture = true;
+	job.target = GL_TEXTURE_2D;
+	job.object = texture;
+	job.level = level;
+	job.width = width;
+	job.height = height;
+	job.nrChannels = nrChannels;
+	job.pixelBuffer = pixelBuffer;
+	job.size = (size_t)width * height * nrChannels;
+	job.uploaded = 0;
+	job.sourceOffset = 0;
+	if (pixelBuffer)
+		job.sourceOffset = (size_t)pixels;
+	else
+		job.data.assign((const unsigned char*)pixels, (const unsigned char*)pixels + job.size);
+	job.done = std::move(done);
+	jobs.push_back(std::move(job));
+	return jobs.back().ticket;
+}
+
+UploadScheduler::Ticket UploadScheduler::uploadBuffer(GLenum target, unsigned int buffer, size_t offset,
+	const void* data, size_t size, int priority, DoneCallback done)
+{
+	Job job;
+	job.ticket = nextTicket++;
+	job.priority = priority;
+	job.texture = false;
+	job.target = target;
+	job.object = buffer;
+	job.level = job.width = job.height = job.nrChannels = 0;
+	job.pixelBuffer = 0;
+	job.sourceOffset = offset;
+	job.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+	job.size = size;
+	job.uploaded = 0;
+	job.done = std::move(done);
+	jobs.push_back(std::move(job));
+	return jobs.back().ticket;
+}
+
+void UploadScheduler::setPriority(Ticket ticket, int priority)
+{
+	for (Job& job : jobs)
+	{
+		if (job.ticket == ticket)
+			job.priority = priority;
+	}
+}
+
+void UploadScheduler::cancel(Ticket ticket)
+{
+	jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+		[ticket](const Job& job) { return job.ticket == ticket; }), jobs.end());
+}
+
+void UploadScheduler::update()
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	Stats frame{ 0, 0, 0, 0.0 };
+
+	// tickets grow, so they break priority ties in request order
+	std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) {
+		return a.priority != b.priority ? a.priority > b.priority : a.ticket < b.ticket;
+	});
+
+	size_t next = 0;
+	while (next < jobs.size() && frame.bytesUploaded < bytesPerFrame)
+	{
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (elapsed >= millisecondsPerFrame)
+			break;
+
+		Job& job = jobs[next];
+		frame.bytesUploaded += uploadSome(job, bytesPerFrame - frame.bytesUploaded);
+		if (job.uploaded == job.size)
+		{
+			DoneCallback done = std::move(job.done);
+			jobs.erase(jobs.begin() + next);
+			frame.uploadsFinished++;
+			// may queue more uploads, they share what's left of the budget
+			if (done)
+				done();
+		}
+		else
+		{
+			next++; // the budget ran out inside this job
+		}
+	}
+
+	GLStateCache::get().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	frame.queueDepth = jobs.size();
+	frame.milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	lastFrame = frame;
+}
+
+size_t UploadScheduler::uploadSome(Job& job, size_t maxBytes)
+{
+	GLStateCache& glState = GLStateCache::get();
+	if (job.uploaded == job.size)
+		return 0; // empty
+	if (!job.texture)
+	{
+		size_t bytes = std::min(maxBytes, job.size - job.uploaded);
+		bytes = bytes ? bytes : 1;
+		glState.bindBuffer(job.target, job.object);
+		glBufferSubData(job.target, job.sourceOffset + job.uploaded, bytes, job.data.data() + job.uploaded);
+		job.uploaded += bytes;
+		return bytes;
+	}
+
+	// whole rows only
+	size_t rowBytes = (size_t)job.width * job.nrChannels;
+	int firstRow = (int)(job.uploaded / rowBytes);
+	int rows = (int)std::min<size_t>(maxBytes / rowBytes, job.height - firstRow);
+	rows = rows > 0 ? rows : 1;
+
+	glState.bindTexture(0, GL_TEXTURE_2D, job.object);
+	glState.bindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pixelBuffer);
+	const unsigned char* source = job.pixelBuffer ?
+		(const unsigned char*)job.sourceOffset : job.data.data();
+	setUnpackAlignment(job.width, job.nrChannels);
+	glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, firstRow, job.width, rows,
+		texturePixelFormat(job.nrChannels), GL_UNSIGNED_BYTE, source + firstRow * rowBytes);
+
+	size_t bytes = rows * rowBytes;
+	job.uploaded += bytes;
+	return bytes;
+}
+
+#endif